@@ -0,0 +1,130 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// bump allocator holding all CPU side data of one loaded model. memory is
+// handed out from a few large blocks and released in one go when the arena
+// is destroyed, objects made with create() are destroyed in reverse order
+// of creation right before that.
+class arena
+{
+public:
+	explicit arena(size_t block_size = 1 << 20)
+		: block_size(block_size)
+	{
+
+	}
+
+	arena(const arena& ) = delete;
+	arena& operator=(const arena& ) = delete;
+	arena(arena&& ) = delete;
+	arena& operator=(arena&& ) = delete;
+
+	~arena()
+	{
+		for (std::vector<destructor>::reverse_iterator iter = destructors.rbegin(); iter != destructors.rend(); ++iter)
+		{
+			iter->destroy(iter->object);
+		}
+
+		for (std::vector<uint8_t*>::iterator iter = blocks.begin(); iter != blocks.end(); ++iter)
+		{
+			delete[] *iter;
+		}
+	}
+
+	void* allocate(size_t size, size_t alignment)
+	{
+		size_t offset = (block_used + alignment - 1) & ~(alignment - 1);
+
+		if (blocks.empty() || offset + size > block_capacity)
+		{
+			// oversized requests get a block of their own
+			block_capacity = std::max(block_size, size + alignment);
+			blocks.push_back(new uint8_t[block_capacity]);
+			bytes_reserved += block_capacity;
+			block_used = 0;
+
+			uintptr_t begin = reinterpret_cast<uintptr_t>(blocks.back());
+			offset = ((begin + alignment - 1) & ~(alignment - 1)) - begin;
+		}
+
+		void* ret = blocks.back() + offset;
+		block_used = offset + size;
+		bytes_allocated += size;
+		++allocations;
+		return ret;
+	}
+
+	// uninitialized storage for count trivial values
+	template <typename T>
+	T* allocate_array(size_t count)
+	{
+		return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+	}
+
+	template <typename T, typename... Args>
+	T* create(Args&&... args)
+	{
+		T* ret = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+
+		if (!std::is_trivially_destructible<T>::value)
+		{
+			destructors.push_back(destructor{&arena::destroy<T>, ret});
+		}
+
+		return ret;
+	}
+
+	size_t allocation_count() const
+	{
+		return allocations;
+	}
+
+	size_t allocated_bytes() const
+	{
+		return bytes_allocated;
+	}
+
+	size_t reserved_bytes() const
+	{
+		return bytes_reserved;
+	}
+
+	size_t block_count() const
+	{
+		return blocks.size();
+	}
+
+private:
+	struct destructor
+	{
+		void (*destroy)(void*);
+		void* object;
+	};
+
+	template <typename T>
+	static void destroy(void* object)
+	{
+		static_cast<T*>(object)->~T();
+	}
+
+	size_t block_size;
+	size_t block_capacity = 0;
+	size_t block_used = 0;
+	std::vector<uint8_t*> blocks;
+	std::vector<destructor> destructors;
+
+	size_t allocations = 0;
+	size_t bytes_allocated = 0;
+	size_t bytes_reserved = 0;
+};
+
+#endif
@@ -0,0 +1,258 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "assimp/Importer.hpp"
+#include "assimp/scene.h"
+#include "assimp/postprocess.h"
+
+#include "cooked_model.h"
+
+// builds the files opengl-playground loads with --model *.cooked. it does not
+// need a window or a GL context, so it can run as part of the build.
+
+enum class cook_result
+{
+	cooked,
+	unchanged,
+	failed
+};
+
+struct cooker_settings
+{
+	cook_options options;
+	// runtime-optimized includes the vertex cache optimization and limits
+	// the bone weights
+	unsigned import_flags = default_import_flags;
+	bool force = false;
+};
+
+// combines the input with everything else that changes the output, so a new
+// cooker version or different settings cook the file again
+uint64_t cook_key(uint64_t content_hash, const cooker_settings& settings)
+{
+	uint64_t ret = content_hash;
+	ret = hash_bytes(&settings.import_flags, sizeof(settings.import_flags), ret);
+	ret = hash_bytes(&cooked_model_version, sizeof(cooked_model_version), ret);
+	ret = hash_bytes(&settings.options.key_tolerance, sizeof(settings.options.key_tolerance), ret);
+	ret = hash_bytes(&settings.options.normalize_weights, sizeof(settings.options.normalize_weights), ret);
+	ret = hash_bytes(&settings.options.vertex_attributes, sizeof(settings.options.vertex_attributes), ret);
+	return ret;
+}
+
+cook_result cook_file(const std::string& in_path, const std::string& out_path, const cooker_settings& settings)
+{
+	uint64_t content_hash;
+
+	if (!hash_file(in_path.c_str(), content_hash))
+	{
+		std::cout << "could not read " << in_path << std::endl;
+		return cook_result::failed;
+	}
+
+	cook_options options = settings.options;
+	options.source_hash = cook_key(content_hash, settings);
+
+	cooked_header existing;
+
+	if (!settings.force && read_cooked_header(out_path.c_str(), existing) && existing.source_hash == options.source_hash)
+	{
+		std::cout << "unchanged " << in_path << std::endl;
+		return cook_result::unchanged;
+	}
+
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(in_path, settings.import_flags);
+
+	if (scene == nullptr)
+	{
+		std::cout << "could not import " << in_path << ": " << importer.GetErrorString() << std::endl;
+		return cook_result::failed;
+	}
+
+	std::vector<cooked_mesh_stats> stats;
+	std::vector<uint8_t> data = cook_scene(scene, options, &stats);
+
+	if (!write_cooked_file(out_path.c_str(), data))
+	{
+		std::cout << "could not write " << out_path << std::endl;
+		return cook_result::failed;
+	}
+
+	std::cout << "cooked " << in_path << " -> " << out_path << ", " << data.size() << " bytes" << std::endl;
+
+	// what the triangle reordering in cook_scene does for the vertex cache,
+	// and the levels of detail it generates
+	for (size_t i = 0; i < stats.size(); ++i)
+	{
+		std::cout << "  mesh " << i << ": ACMR " << stats[i].acmr_before << " -> " << stats[i].acmr_after
+				  << ", triangles per level of detail";
+
+		for (std::vector<uint32_t>::const_iterator iter = stats[i].triangles_per_lod.begin(); iter != stats[i].triangles_per_lod.end(); ++iter)
+		{
+			std::cout << " " << *iter;
+		}
+
+		std::cout << std::endl;
+	}
+
+	if (options.vertex_attributes & vertex_compressed)
+	{
+		vertex_error error = measure_vertex_error(scene, options.vertex_attributes);
+		std::cout << "  max vertex error: position " << error.position << ", uv " << error.uv
+				  << ", normal " << error.normal << " degrees" << std::endl;
+	}
+	return cook_result::cooked;
+}
+
+bool is_directory(const std::string& path)
+{
+	struct stat st;
+	return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool is_regular_file(const std::string& path)
+{
+	struct stat st;
+	return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+// every file in in_dir Assimp has an importer for, not recursive
+std::vector<std::string> find_inputs(const std::string& in_dir)
+{
+	std::vector<std::string> ret;
+	DIR* dir = opendir(in_dir.c_str());
+
+	if (dir == nullptr)
+	{
+		return ret;
+	}
+
+	Assimp::Importer importer;
+
+	while (dirent* entry = readdir(dir))
+	{
+		std::string name = entry->d_name;
+		size_t dot = name.rfind('.');
+
+		if (dot != std::string::npos && dot > 0 && is_regular_file(in_dir + "/" + name) &&
+			importer.IsExtensionSupported(name.substr(dot)))
+		{
+			ret.push_back(name);
+		}
+	}
+
+	closedir(dir);
+	std::sort(ret.begin(), ret.end());
+	return ret;
+}
+
+int usage()
+{
+	std::cout << "usage: asset-cooker [options] <input file> <output file>" << std::endl
+			  << "       asset-cooker [options] --batch <input directory> <output directory>" << std::endl
+			  << "options:" << std::endl
+			  << "  --profile <name>     Assimp import profile (default runtime-optimized)" << std::endl
+			  << "  --key-tolerance <t>  drop animation keys reproduced within t (default 0.0001)" << std::endl
+			  << "  --keep-weights       do not normalize bone weights" << std::endl
+			  << "  --normals            store vertex normals for --lighting" << std::endl
+			  << "  --compress           quantize the vertices, for --compress-vertices" << std::endl
+			  << "  --force              cook even if the output is up to date" << std::endl;
+	return 2;
+}
+
+int main(int argc, char* argv[])
+{
+	cooker_settings settings;
+	settings.options.key_tolerance = 0.0001f;
+	settings.options.normalize_weights = true;
+
+	bool batch = false;
+	std::vector<std::string> paths;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--batch")
+		{
+			batch = true;
+		}
+		else if (arg == "--force")
+		{
+			settings.force = true;
+		}
+		else if (arg == "--keep-weights")
+		{
+			settings.options.normalize_weights = false;
+		}
+		else if (arg == "--normals")
+		{
+			settings.options.vertex_attributes |= vertex_normal;
+		}
+		else if (arg == "--compress")
+		{
+			settings.options.vertex_attributes |= vertex_compressed;
+		}
+		else if (arg == "--profile" && i + 1 < argc)
+		{
+			const import_profile* profile = find_import_profile(argv[++i]);
+
+			if (profile == nullptr)
+			{
+				return usage();
+			}
+
+			settings.import_flags = profile->flags;
+		}
+		else if (arg == "--key-tolerance" && i + 1 < argc)
+		{
+			settings.options.key_tolerance = std::atof(argv[++i]);
+		}
+		else if (arg.compare(0, 2, "--") == 0)
+		{
+			return usage();
+		}
+		else
+		{
+			paths.push_back(arg);
+		}
+	}
+
+	if (paths.size() != 2)
+	{
+		return usage();
+	}
+
+	if (!batch)
+	{
+		return cook_file(paths[0], paths[1], settings) == cook_result::failed ? 1 : 0;
+	}
+
+	if (!is_directory(paths[0]) || !is_directory(paths[1]))
+	{
+		std::cout << "--batch needs an existing input and output directory" << std::endl;
+		return 1;
+	}
+
+	int counts[3] = {};
+	std::vector<std::string> inputs = find_inputs(paths[0]);
+
+	for (std::vector<std::string>::iterator iter = inputs.begin(); iter != inputs.end(); ++iter)
+	{
+		cook_result result = cook_file(paths[0] + "/" + *iter, paths[1] + "/" + *iter + ".cooked", settings);
+		++counts[static_cast<int>(result)];
+	}
+
+	std::cout << counts[static_cast<int>(cook_result::cooked)] << " cooked, "
+			  << counts[static_cast<int>(cook_result::unchanged)] << " unchanged, "
+			  << counts[static_cast<int>(cook_result::failed)] << " failed" << std::endl;
+
+	return counts[static_cast<int>(cook_result::failed)] > 0 ? 1 : 0;
+}
@@ -0,0 +1,261 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "vector_math.h"
+
+// bounding volume hierarchy over the boxes of many objects, usually model
+// instances, for frustum culling and picking. objects are referred to by
+// their index into the boxes given to build(). moving objects are handled
+// by refit(), which keeps the tree structure, so the tree gets worse the
+// further they move from where they were at build() time.
+class bvh
+{
+public:
+	bvh()
+	{
+
+	}
+
+	bvh(const bvh& ) = delete;
+	bvh& operator=(const bvh& ) = delete;
+	bvh(bvh&& ) = delete;
+	bvh& operator=(bvh&& ) = delete;
+
+	// median split along the longest axis of the box centers
+	void build(const std::vector<bounding_box>& boxes)
+	{
+		nodes.clear();
+		items.resize(boxes.size());
+		centers.resize(boxes.size());
+		leaf_boxes.resize(boxes.size());
+
+		for (size_t i = 0; i < boxes.size(); ++i)
+		{
+			items[i] = static_cast<int>(i);
+			centers[i] = boxes[i].center();
+		}
+
+		if (boxes.empty())
+		{
+			return;
+		}
+
+		nodes.reserve(2 * boxes.size() / max_leaf_items + 1);
+		nodes.push_back(node());
+		build_node(0, 0, static_cast<int>(boxes.size()), boxes);
+	}
+
+	// updates the node boxes for objects that moved, boxes must hold as
+	// many objects as at build() time
+	void refit(const std::vector<bounding_box>& boxes)
+	{
+		// children always come after their parent
+		for (std::vector<node>::reverse_iterator iter = nodes.rbegin(); iter != nodes.rend(); ++iter)
+		{
+			iter->box = bounding_box();
+
+			if (iter->child == 0)
+			{
+				for (int i = iter->first_item; i < iter->first_item + iter->item_count; ++i)
+				{
+					leaf_boxes[i] = boxes[items[i]];
+					iter->box.add(leaf_boxes[i]);
+				}
+			}
+			else
+			{
+				iter->box.add(nodes[iter->child].box);
+				iter->box.add(nodes[iter->child + 1].box);
+			}
+		}
+	}
+
+	// appends the objects whose boxes are at least partially in f to out.
+	// their boxes are not tested if a whole subtree is inside.
+	void query(const frustum& f, std::vector<int>& out) const
+	{
+		if (nodes.empty())
+		{
+			return;
+		}
+
+		int stack[max_depth];
+		int stack_size = 0;
+		stack[stack_size++] = 0;
+
+		while (stack_size > 0)
+		{
+			const node& n = nodes[stack[--stack_size]];
+			containment c = box_in_frustum(f, n.box);
+
+			if (c == containment::outside)
+			{
+				continue;
+			}
+
+			if (c == containment::inside)
+			{
+				out.insert(out.end(), items.begin() + n.first_item, items.begin() + n.first_item + n.item_count);
+				continue;
+			}
+
+			if (n.child == 0)
+			{
+				for (int i = n.first_item; i < n.first_item + n.item_count; ++i)
+				{
+					if (box_in_frustum(f, leaf_boxes[i]) != containment::outside)
+					{
+						out.push_back(items[i]);
+					}
+				}
+
+				continue;
+			}
+
+			stack[stack_size++] = n.child;
+			stack[stack_size++] = n.child + 1;
+		}
+	}
+
+	// the object whose box the ray enters first, or -1. distance is where
+	// it enters, in units of direction.
+	int raycast(const vector3& origin, const vector3& direction, float& distance) const
+	{
+		vector3 inverse_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+		int ret = -1;
+		distance = HUGE_VALF;
+
+		if (nodes.empty())
+		{
+			return ret;
+		}
+
+		int stack[max_depth];
+		int stack_size = 0;
+		stack[stack_size++] = 0;
+
+		while (stack_size > 0)
+		{
+			const node& n = nodes[stack[--stack_size]];
+			float enter;
+
+			if (!ray_hits_box(origin, inverse_direction, n.box, distance, enter))
+			{
+				continue;
+			}
+
+			if (n.child == 0)
+			{
+				for (int i = n.first_item; i < n.first_item + n.item_count; ++i)
+				{
+					if (ray_hits_box(origin, inverse_direction, leaf_boxes[i], distance, enter) && enter < distance)
+					{
+						distance = enter;
+						ret = items[i];
+					}
+				}
+
+				continue;
+			}
+
+			// the nearer child goes on top, so hits in it can skip the other
+			float enter_first;
+			float enter_second;
+			bool hits_first = ray_hits_box(origin, inverse_direction, nodes[n.child].box, distance, enter_first);
+			bool hits_second = ray_hits_box(origin, inverse_direction, nodes[n.child + 1].box, distance, enter_second);
+
+			if (hits_first && hits_second)
+			{
+				stack[stack_size++] = enter_first < enter_second ? n.child + 1 : n.child;
+				stack[stack_size++] = enter_first < enter_second ? n.child : n.child + 1;
+			}
+			else if (hits_first || hits_second)
+			{
+				stack[stack_size++] = hits_first ? n.child : n.child + 1;
+			}
+		}
+
+		return ret;
+	}
+
+	size_t node_count() const
+	{
+		return nodes.size();
+	}
+
+private:
+	struct node
+	{
+		bounding_box box;
+		// the second child follows the first, 0 for leaves
+		int child = 0;
+		// the objects below this node, a range of items
+		int first_item = 0;
+		int item_count = 0;
+	};
+
+	// median splits keep the depth at log2 of the object count
+	static const int max_depth = 64;
+	static const int max_leaf_items = 4;
+
+	static float component(const vector3& v, int axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+
+	void build_node(int index, int begin, int end, const std::vector<bounding_box>& boxes)
+	{
+		bounding_box box;
+		bounding_box center_box;
+
+		for (int i = begin; i < end; ++i)
+		{
+			box.add(boxes[items[i]]);
+			center_box.add(centers[items[i]]);
+		}
+
+		nodes[index].box = box;
+		nodes[index].first_item = begin;
+		nodes[index].item_count = end - begin;
+
+		if (end - begin <= max_leaf_items)
+		{
+			for (int i = begin; i < end; ++i)
+			{
+				leaf_boxes[i] = boxes[items[i]];
+			}
+
+			return;
+		}
+
+		vector3 extent = center_box.max - center_box.min;
+		int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+		int middle = begin + (end - begin) / 2;
+
+		std::nth_element(items.begin() + begin, items.begin() + middle, items.begin() + end, [&](int a, int b)
+		{
+			return component(centers[a], axis) < component(centers[b], axis);
+		});
+
+		int child = static_cast<int>(nodes.size());
+		nodes[index].child = child;
+		nodes.push_back(node());
+		nodes.push_back(node());
+		build_node(child, begin, middle, boxes);
+		build_node(child + 1, middle, end, boxes);
+	}
+
+	std::vector<node> nodes;
+	// object indices, sorted so every node covers a range of them
+	std::vector<int> items;
+	std::vector<vector3> centers;
+	// the object boxes in items order, so leaves read them without the
+	// caller's array
+	std::vector<bounding_box> leaf_boxes;
+};
+
+#endif
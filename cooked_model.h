@@ -0,0 +1,1862 @@
+#ifndef COOKED_MODEL_H
+#define COOKED_MODEL_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "assimp/scene.h"
+#include "assimp/postprocess.h"
+
+#include "vector_math.h"
+
+// named sets of post-processing steps for Assimp::Importer::ReadFile.
+// triangulation is always needed, the runtime only draws triangles.
+struct import_profile
+{
+	const char* name;
+	unsigned flags;
+};
+
+const import_profile import_profiles[] =
+{
+	// as little as possible, for quick iteration on assets
+	{"fast-preview", aiProcess_Triangulate | aiProcess_SortByPType},
+	// what the runtime actually uses, no tangents or normals
+	{"runtime-optimized", aiProcess_Triangulate            |
+						  aiProcess_JoinIdenticalVertices  |
+						  aiProcess_SortByPType            |
+						  aiProcess_LimitBoneWeights       |
+						  aiProcess_ImproveCacheLocality   |
+						  aiProcess_OptimizeMeshes},
+	// everything that could matter, including validation
+	{"full", aiProcess_ValidateDataStructure    |
+			 aiProcess_RemoveRedundantMaterials |
+			 aiProcess_OptimizeMeshes           |
+			 aiProcess_Triangulate              |
+			 aiProcess_SortByPType              |
+			 aiProcess_FindInvalidData          |
+			 aiProcess_GenSmoothNormals         |
+			 aiProcess_CalcTangentSpace         |
+			 aiProcess_JoinIdenticalVertices    |
+			 aiProcess_LimitBoneWeights         |
+			 aiProcess_ImproveCacheLocality}
+};
+
+const int import_profile_count = sizeof(import_profiles) / sizeof(import_profiles[0]);
+
+// returns nullptr for unknown names
+inline const import_profile* find_import_profile(const std::string& name)
+{
+	for (int i = 0; i < import_profile_count; ++i)
+	{
+		if (name == import_profiles[i].name)
+		{
+			return &import_profiles[i];
+		}
+	}
+
+	return nullptr;
+}
+
+// runtime-optimized, used unless something else is asked for
+const unsigned default_import_flags = import_profiles[1].flags;
+
+// attributes a vertex can have besides its position, or-ed together to say
+// what the renderer needs
+enum vertex_attribute : unsigned
+{
+	vertex_uv = 1,
+	vertex_normal = 2,
+	// not an attribute, stores all of them in the compact formats below
+	vertex_compressed = 4
+};
+
+// the playground renders unlit and textured
+const unsigned default_vertex_attributes = vertex_uv;
+
+// how an attribute is stored
+enum vertex_format : int32_t
+{
+	format_float,
+	// 16 bit signed integers, decoded as bias + value * scale
+	format_quantized,
+	// normals only: two 16 bit signed integers, octahedral encoding
+	format_octahedral,
+	// normals only: three normalized signed bytes and one byte padding
+	format_snorm8
+};
+
+// byte offsets of the attributes inside one vertex, -1 for attributes that
+// are not stored. every vertex has a position.
+struct vertex_layout
+{
+	int32_t uv_offset;
+	int32_t normal_offset;
+	int32_t position_offset;
+	int32_t size;
+	int32_t uv_format;
+	int32_t normal_format;
+	int32_t position_format;
+	// ranges of the quantized attributes. positions use one scale for all
+	// axes, so undoing it with the modelview matrix does not skew normals.
+	float uv_bias[2];
+	float uv_scale[2];
+	float position_bias[3];
+	float position_scale;
+};
+
+const float quantized_max = 32767.0f;
+
+inline int16_t quantize(float value, float bias, float scale)
+{
+	if (scale == 0.0f)
+	{
+		return 0;
+	}
+
+	return static_cast<int16_t>(std::max(-quantized_max, std::min(quantized_max, std::round((value - bias) / scale))));
+}
+
+// bias and scale that map [min, max] onto the quantized range
+inline void quantization_range(float min, float max, float& bias, float& scale)
+{
+	bias = 0.5f * (min + max);
+	scale = 0.5f * (max - min) / quantized_max;
+}
+
+// the same for positions, which share the scale of the longest axis
+inline void quantization_range(const vector3& min, const vector3& max, vertex_layout& layout)
+{
+	layout.position_bias[0] = 0.5f * (min.x + max.x);
+	layout.position_bias[1] = 0.5f * (min.y + max.y);
+	layout.position_bias[2] = 0.5f * (min.z + max.z);
+	layout.position_scale = 0.5f * std::max(max.x - min.x, std::max(max.y - min.y, max.z - min.z)) / quantized_max;
+}
+
+inline float sign_not_zero(float value)
+{
+	return value < 0.0f ? -1.0f : 1.0f;
+}
+
+// projects the unit vector n onto an octahedron and unfolds the lower half
+// over the upper one, which leaves two coordinates in [-1, 1]
+inline void encode_octahedral(const vector3& n, int16_t* out)
+{
+	float length = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+	float u = length > 0.0f ? n.x / length : 0.0f;
+	float v = length > 0.0f ? n.y / length : 0.0f;
+
+	if (n.z < 0.0f)
+	{
+		float folded_u = (1.0f - std::fabs(v)) * sign_not_zero(u);
+		v = (1.0f - std::fabs(u)) * sign_not_zero(v);
+		u = folded_u;
+	}
+
+	out[0] = quantize(u, 0.0f, 1.0f / quantized_max);
+	out[1] = quantize(v, 0.0f, 1.0f / quantized_max);
+}
+
+inline vector3 decode_octahedral(const int16_t* in)
+{
+	float u = in[0] / quantized_max;
+	float v = in[1] / quantized_max;
+	float z = 1.0f - std::fabs(u) - std::fabs(v);
+
+	if (z < 0.0f)
+	{
+		float unfolded_u = (1.0f - std::fabs(v)) * sign_not_zero(u);
+		v = (1.0f - std::fabs(u)) * sign_not_zero(v);
+		u = unfolded_u;
+	}
+
+	float length = std::sqrt(u * u + v * v + z * z);
+	return vector3(u / length, v / length, z / length);
+}
+
+// the accessors below convert between floats and the format of the layout
+
+inline vector3 read_position(const uint8_t* vertex, const vertex_layout& layout)
+{
+	const uint8_t* p = vertex + layout.position_offset;
+
+	if (layout.position_format == format_quantized)
+	{
+		const int16_t* q = reinterpret_cast<const int16_t*>(p);
+		return vector3(layout.position_bias[0] + q[0] * layout.position_scale,
+					   layout.position_bias[1] + q[1] * layout.position_scale,
+					   layout.position_bias[2] + q[2] * layout.position_scale);
+	}
+
+	return *reinterpret_cast<const vector3*>(p);
+}
+
+inline void write_position(uint8_t* vertex, const vertex_layout& layout, const vector3& position)
+{
+	uint8_t* p = vertex + layout.position_offset;
+
+	if (layout.position_format == format_quantized)
+	{
+		int16_t* q = reinterpret_cast<int16_t*>(p);
+		q[0] = quantize(position.x, layout.position_bias[0], layout.position_scale);
+		q[1] = quantize(position.y, layout.position_bias[1], layout.position_scale);
+		q[2] = quantize(position.z, layout.position_bias[2], layout.position_scale);
+		q[3] = 0;
+		return;
+	}
+
+	*reinterpret_cast<vector3*>(p) = position;
+}
+
+inline vector3 read_normal(const uint8_t* vertex, const vertex_layout& layout)
+{
+	const uint8_t* p = vertex + layout.normal_offset;
+
+	switch (layout.normal_format)
+	{
+	case format_octahedral:
+		return decode_octahedral(reinterpret_cast<const int16_t*>(p));
+	case format_snorm8:
+	{
+		const int8_t* q = reinterpret_cast<const int8_t*>(p);
+		return vector3(std::max(q[0] / 127.0f, -1.0f), std::max(q[1] / 127.0f, -1.0f), std::max(q[2] / 127.0f, -1.0f));
+	}
+	default:
+		return *reinterpret_cast<const vector3*>(p);
+	}
+}
+
+inline void write_normal(uint8_t* vertex, const vertex_layout& layout, const vector3& normal)
+{
+	uint8_t* p = vertex + layout.normal_offset;
+
+	switch (layout.normal_format)
+	{
+	case format_octahedral:
+		encode_octahedral(normal, reinterpret_cast<int16_t*>(p));
+		break;
+	case format_snorm8:
+	{
+		int8_t* q = reinterpret_cast<int8_t*>(p);
+		q[0] = static_cast<int8_t>(std::round(std::max(-1.0f, std::min(1.0f, normal.x)) * 127.0f));
+		q[1] = static_cast<int8_t>(std::round(std::max(-1.0f, std::min(1.0f, normal.y)) * 127.0f));
+		q[2] = static_cast<int8_t>(std::round(std::max(-1.0f, std::min(1.0f, normal.z)) * 127.0f));
+		q[3] = 0;
+		break;
+	}
+	default:
+		*reinterpret_cast<vector3*>(p) = normal;
+		break;
+	}
+}
+
+inline void read_uv(const uint8_t* vertex, const vertex_layout& layout, float* out)
+{
+	const uint8_t* p = vertex + layout.uv_offset;
+
+	if (layout.uv_format == format_quantized)
+	{
+		const int16_t* q = reinterpret_cast<const int16_t*>(p);
+		out[0] = layout.uv_bias[0] + q[0] * layout.uv_scale[0];
+		out[1] = layout.uv_bias[1] + q[1] * layout.uv_scale[1];
+		return;
+	}
+
+	std::memcpy(out, p, 2 * sizeof(float));
+}
+
+inline void write_uv(uint8_t* vertex, const vertex_layout& layout, float u, float v)
+{
+	uint8_t* p = vertex + layout.uv_offset;
+
+	if (layout.uv_format == format_quantized)
+	{
+		int16_t* q = reinterpret_cast<int16_t*>(p);
+		q[0] = quantize(u, layout.uv_bias[0], layout.uv_scale[0]);
+		q[1] = quantize(v, layout.uv_bias[1], layout.uv_scale[1]);
+		return;
+	}
+
+	float* f = reinterpret_cast<float*>(p);
+	f[0] = u;
+	f[1] = v;
+}
+
+inline matrix4 convert_assimp_matrix(const aiMatrix4x4& mat)
+{
+	return matrix4(mat.a1, mat.a2, mat.a3, mat.a4,
+				   mat.b1, mat.b2, mat.b3, mat.b4,
+				   mat.c1, mat.c2, mat.c3, mat.c4,
+				   mat.d1, mat.d2, mat.d3, mat.d4);
+}
+
+// smallest layout with those of the requested attributes m can fill. UVs
+// are left out if the material of m has no texture to map with them. with
+// vertex_compressed UVs and positions are quantized to the range m uses and
+// normals octahedral encoded, which about halves the vertex size.
+inline vertex_layout choose_vertex_layout(const aiScene* scene, const aiMesh* m, unsigned attributes)
+{
+	vertex_layout ret = vertex_layout();
+	ret.uv_offset = -1;
+	ret.normal_offset = -1;
+	bool compressed = (attributes & vertex_compressed) != 0;
+
+	bool textured = m->mMaterialIndex < scene->mNumMaterials &&
+					scene->mMaterials[m->mMaterialIndex]->GetTextureCount(aiTextureType_DIFFUSE) > 0;
+
+	if ((attributes & vertex_uv) && textured && m->HasTextureCoords(0))
+	{
+		ret.uv_offset = ret.size;
+
+		if (compressed)
+		{
+			ret.uv_format = format_quantized;
+			ret.size += 2 * sizeof(int16_t);
+
+			for (int j = 0; j < 2 && m->mNumVertices > 0; ++j)
+			{
+				float min = m->mTextureCoords[0][0][j];
+				float max = min;
+
+				for (unsigned i = 1; i < m->mNumVertices; ++i)
+				{
+					min = std::min(min, m->mTextureCoords[0][i][j]);
+					max = std::max(max, m->mTextureCoords[0][i][j]);
+				}
+
+				quantization_range(min, max, ret.uv_bias[j], ret.uv_scale[j]);
+			}
+		}
+		else
+		{
+			ret.uv_format = format_float;
+			ret.size += 2 * sizeof(float);
+		}
+	}
+
+	if ((attributes & vertex_normal) && m->HasNormals())
+	{
+		ret.normal_offset = ret.size;
+		ret.normal_format = compressed ? format_octahedral : format_float;
+		ret.size += compressed ? 2 * sizeof(int16_t) : 3 * sizeof(float);
+	}
+
+	ret.position_offset = ret.size;
+
+	if (compressed)
+	{
+		// padded to 4 components to keep every vertex 4 byte aligned
+		ret.position_format = format_quantized;
+		ret.size += 4 * sizeof(int16_t);
+
+		vector3 min(HUGE_VALF, HUGE_VALF, HUGE_VALF);
+		vector3 max(-HUGE_VALF, -HUGE_VALF, -HUGE_VALF);
+
+		for (unsigned i = 0; i < m->mNumVertices; ++i)
+		{
+			min = vector3(std::min(min.x, m->mVertices[i].x), std::min(min.y, m->mVertices[i].y), std::min(min.z, m->mVertices[i].z));
+			max = vector3(std::max(max.x, m->mVertices[i].x), std::max(max.y, m->mVertices[i].y), std::max(max.z, m->mVertices[i].z));
+		}
+
+		if (m->mNumVertices > 0)
+		{
+			quantization_range(min, max, ret);
+		}
+	}
+	else
+	{
+		ret.position_format = format_float;
+		ret.size += 3 * sizeof(float);
+	}
+
+	return ret;
+}
+
+// bytes an attribute with the given components takes in format
+inline int32_t attribute_size(int32_t format, int32_t components)
+{
+	switch (format)
+	{
+	case format_float:
+		return components * sizeof(float);
+	case format_quantized:
+		return components * sizeof(int16_t);
+	case format_octahedral:
+		return 2 * sizeof(int16_t);
+	case format_snorm8:
+		return 4;
+	default:
+		return -1;
+	}
+}
+
+// checks that the formats fit the attributes and every stored attribute
+// fits into the vertex
+inline bool valid_vertex_layout(const vertex_layout& layout)
+{
+	int32_t position_size = attribute_size(layout.position_format, 3);
+	int32_t uv_size = attribute_size(layout.uv_format, 2);
+	int32_t normal_size = attribute_size(layout.normal_format, 3);
+
+	return layout.size > 0 && layout.size % 4 == 0 &&
+		   (layout.position_format == format_float || layout.position_format == format_quantized) &&
+		   layout.position_offset >= 0 && layout.position_offset % 4 == 0 && layout.position_offset + position_size <= layout.size &&
+		   (layout.uv_offset == -1 || ((layout.uv_format == format_float || layout.uv_format == format_quantized) &&
+		   layout.uv_offset >= 0 && layout.uv_offset % 4 == 0 && layout.uv_offset + uv_size <= layout.size)) &&
+		   (layout.normal_offset == -1 || (normal_size > 0 && layout.normal_format != format_quantized &&
+		   layout.normal_offset >= 0 && layout.normal_offset % 4 == 0 && layout.normal_offset + normal_size <= layout.size));
+}
+
+// writes the vertices of m to out in the given layout. remap gives the
+// position of every vertex in out, nullptr keeps the order.
+inline void pack_assimp_vertices(const aiMesh* m, const vertex_layout& layout, uint8_t* out, const uint32_t* remap = nullptr)
+{
+	for (unsigned i = 0; i < m->mNumVertices; ++i)
+	{
+		uint8_t* vertex = out + (remap != nullptr ? remap[i] : i) * layout.size;
+
+		if (layout.uv_offset >= 0)
+		{
+			write_uv(vertex, layout, m->mTextureCoords[0][i].x, m->mTextureCoords[0][i].y);
+		}
+
+		if (layout.normal_offset >= 0)
+		{
+			write_normal(vertex, layout, vector3(m->mNormals[i].x, m->mNormals[i].y, m->mNormals[i].z));
+		}
+
+		write_position(vertex, layout, vector3(m->mVertices[i].x, m->mVertices[i].y, m->mVertices[i].z));
+	}
+}
+
+// largest differences between the float attributes of an aiMesh and what
+// packed vertices decode to, normals in degrees
+struct vertex_error
+{
+	float position = 0.0f;
+	float uv = 0.0f;
+	float normal = 0.0f;
+};
+
+inline void measure_vertex_error(const aiMesh* m, const vertex_layout& layout, const uint8_t* vertices, vertex_error& error)
+{
+	for (unsigned i = 0; i < m->mNumVertices; ++i)
+	{
+		const uint8_t* vertex = vertices + i * layout.size;
+		vector3 position = read_position(vertex, layout);
+		error.position = std::max(error.position, std::max(std::fabs(position.x - m->mVertices[i].x),
+								  std::max(std::fabs(position.y - m->mVertices[i].y), std::fabs(position.z - m->mVertices[i].z))));
+
+		if (layout.uv_offset >= 0)
+		{
+			float uv[2];
+			read_uv(vertex, layout, uv);
+			error.uv = std::max(error.uv, std::max(std::fabs(uv[0] - m->mTextureCoords[0][i].x), std::fabs(uv[1] - m->mTextureCoords[0][i].y)));
+		}
+
+		if (layout.normal_offset >= 0)
+		{
+			vector3 normal = read_normal(vertex, layout);
+			const aiVector3D& expected = m->mNormals[i];
+			float length = std::sqrt(expected.x * expected.x + expected.y * expected.y + expected.z * expected.z);
+
+			if (length > 0.0f)
+			{
+				float cosine = (normal.x * expected.x + normal.y * expected.y + normal.z * expected.z) / length;
+				error.normal = std::max(error.normal, std::acos(std::max(-1.0f, std::min(1.0f, cosine))) * 57.29578f);
+			}
+		}
+	}
+}
+
+// packs every mesh of scene the way cook_scene would and measures the error
+inline vertex_error measure_vertex_error(const aiScene* scene, unsigned attributes)
+{
+	vertex_error ret;
+	std::vector<uint8_t> vertices;
+
+	for (unsigned i = 0; i < scene->mNumMeshes; ++i)
+	{
+		const aiMesh* m = scene->mMeshes[i];
+		vertex_layout layout = choose_vertex_layout(scene, m, attributes);
+		vertices.resize(m->mNumVertices * layout.size);
+		pack_assimp_vertices(m, layout, vertices.data());
+		measure_vertex_error(m, layout, vertices.data(), ret);
+	}
+
+	return ret;
+}
+
+// smallest index size in bytes that can address vertex_count vertices: 1, 2
+// or 4
+inline int index_size_for(unsigned vertex_count)
+{
+	if (vertex_count <= 0x100)
+	{
+		return 1;
+	}
+
+	return vertex_count <= 0x10000 ? 2 : 4;
+}
+
+// three indices per face, all faces are assumed to be triangles
+inline std::vector<uint32_t> read_assimp_triangles(const aiMesh* m)
+{
+	std::vector<uint32_t> ret;
+	ret.reserve(m->mNumFaces * 3);
+
+	for (const aiFace* iter = m->mFaces; iter < m->mFaces + m->mNumFaces; ++iter)
+	{
+		ret.push_back(iter->mIndices[0]);
+		ret.push_back(iter->mIndices[1]);
+		ret.push_back(iter->mIndices[2]);
+	}
+
+	return ret;
+}
+
+// entries of the FIFO post-transform cache the optimization aims for
+const int vertex_cache_size = 16;
+
+// average cache miss ratio: vertices a FIFO cache of cache_size entries has
+// to transform per triangle, between 0.5 and 3
+inline float average_cache_miss_ratio(const std::vector<uint32_t>& indices, int cache_size = vertex_cache_size)
+{
+	if (indices.empty())
+	{
+		return 0.0f;
+	}
+
+	std::vector<uint32_t> cache(cache_size, UINT32_MAX);
+	size_t next = 0;
+	size_t misses = 0;
+
+	for (std::vector<uint32_t>::const_iterator iter = indices.begin(); iter != indices.end(); ++iter)
+	{
+		if (std::find(cache.begin(), cache.end(), *iter) == cache.end())
+		{
+			cache[next] = *iter;
+			next = (next + 1) % cache.size();
+			++misses;
+		}
+	}
+
+	return static_cast<float>(misses) / (indices.size() / 3);
+}
+
+// reorders the triangles for the post-transform vertex cache with Tipsify
+// (Sander, Nehab and Barczak 2007): fans around one vertex at a time and
+// moves on to the neighbour that is still in the cache and has the fewest
+// triangles left, which runs in linear time
+inline void optimize_vertex_cache(std::vector<uint32_t>& indices, unsigned vertex_count, int cache_size = vertex_cache_size)
+{
+	size_t triangle_count = indices.size() / 3;
+
+	// triangles using each vertex, as offsets into one array
+	std::vector<uint32_t> live(vertex_count, 0);
+
+	for (std::vector<uint32_t>::const_iterator iter = indices.begin(); iter != indices.end(); ++iter)
+	{
+		++live[*iter];
+	}
+
+	std::vector<uint32_t> offsets(vertex_count + 1, 0);
+
+	for (unsigned i = 0; i < vertex_count; ++i)
+	{
+		offsets[i + 1] = offsets[i] + live[i];
+	}
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+
+	for (size_t i = 0; i < indices.size(); ++i)
+	{
+		adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	std::vector<bool> emitted(triangle_count, false);
+	// time each vertex entered the cache
+	std::vector<int> cache_time(vertex_count, 0);
+	std::vector<uint32_t> dead_end;
+	std::vector<uint32_t> candidates;
+	int time = cache_size + 1;
+	unsigned cursor = 0;
+	int fanning = vertex_count > 0 ? 0 : -1;
+
+	while (fanning >= 0)
+	{
+		candidates.clear();
+
+		for (uint32_t i = offsets[fanning]; i < offsets[fanning + 1]; ++i)
+		{
+			uint32_t t = adjacency[i];
+
+			if (emitted[t])
+			{
+				continue;
+			}
+
+			for (int j = 0; j < 3; ++j)
+			{
+				uint32_t v = indices[t * 3 + j];
+				result.push_back(v);
+				dead_end.push_back(v);
+				candidates.push_back(v);
+				--live[v];
+
+				if (time - cache_time[v] > cache_size)
+				{
+					cache_time[v] = time++;
+				}
+			}
+
+			emitted[t] = true;
+		}
+
+		// the candidate that will still be in the cache after its remaining
+		// triangles are emitted, and entered it the earliest
+		fanning = -1;
+		int best = -1;
+
+		for (std::vector<uint32_t>::const_iterator iter = candidates.begin(); iter != candidates.end(); ++iter)
+		{
+			if (live[*iter] == 0)
+			{
+				continue;
+			}
+
+			int priority = 0;
+
+			if (time - cache_time[*iter] + 2 * static_cast<int>(live[*iter]) <= cache_size)
+			{
+				priority = time - cache_time[*iter];
+			}
+
+			if (priority > best)
+			{
+				best = priority;
+				fanning = *iter;
+			}
+		}
+
+		// otherwise the most recent vertex with triangles left, or the next
+		// one in input order
+		while (fanning < 0 && !dead_end.empty())
+		{
+			if (live[dead_end.back()] > 0)
+			{
+				fanning = dead_end.back();
+			}
+
+			dead_end.pop_back();
+		}
+
+		while (fanning < 0 && cursor < vertex_count)
+		{
+			if (live[cursor] > 0)
+			{
+				fanning = cursor;
+			}
+
+			++cursor;
+		}
+	}
+
+	indices.swap(result);
+}
+
+// renumbers the vertices in the order the triangles first use them, so the
+// vertex fetches walk through memory. returns the new index of every vertex,
+// unused vertices go to the end.
+inline std::vector<uint32_t> optimize_vertex_fetch(std::vector<uint32_t>& indices, unsigned vertex_count)
+{
+	std::vector<uint32_t> remap(vertex_count, UINT32_MAX);
+	uint32_t next = 0;
+
+	for (std::vector<uint32_t>::iterator iter = indices.begin(); iter != indices.end(); ++iter)
+	{
+		if (remap[*iter] == UINT32_MAX)
+		{
+			remap[*iter] = next++;
+		}
+
+		*iter = remap[*iter];
+	}
+
+	for (std::vector<uint32_t>::iterator iter = remap.begin(); iter != remap.end(); ++iter)
+	{
+		if (*iter == UINT32_MAX)
+		{
+			*iter = next++;
+		}
+	}
+
+	return remap;
+}
+
+// error quadric of Garland and Heckbert: the sum of the squared distances
+// of a point to a set of planes, stored as the upper half of a symmetric
+// 4x4 matrix
+struct quadric
+{
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+};
+
+inline void add_plane(quadric& q, const vector3& normal, float distance)
+{
+	double a = normal.x, b = normal.y, c = normal.z, d = distance;
+	q.a2 += a * a; q.ab += a * b; q.ac += a * c; q.ad += a * d;
+	q.b2 += b * b; q.bc += b * c; q.bd += b * d;
+	q.c2 += c * c; q.cd += c * d;
+	q.d2 += d * d;
+}
+
+inline void add_quadric(quadric& q, const quadric& r)
+{
+	q.a2 += r.a2; q.ab += r.ab; q.ac += r.ac; q.ad += r.ad;
+	q.b2 += r.b2; q.bc += r.bc; q.bd += r.bd;
+	q.c2 += r.c2; q.cd += r.cd;
+	q.d2 += r.d2;
+}
+
+inline double quadric_error(const quadric& q, const vector3& p)
+{
+	double x = p.x, y = p.y, z = p.z;
+	double ret = q.a2 * x * x + 2.0 * q.ab * x * y + 2.0 * q.ac * x * z + 2.0 * q.ad * x +
+				 q.b2 * y * y + 2.0 * q.bc * y * z + 2.0 * q.bd * y +
+				 q.c2 * z * z + 2.0 * q.cd * z +
+				 q.d2;
+	return std::max(ret, 0.0);
+}
+
+// one vertex moved onto a neighbour, stale once either of them changed
+struct edge_collapse
+{
+	double cost;
+	uint32_t from;
+	uint32_t to;
+	uint32_t from_version;
+	uint32_t to_version;
+
+	bool operator < (const edge_collapse& other) const
+	{
+		// std::push_heap keeps the largest element in front
+		return cost > other.cost;
+	}
+};
+
+// removes triangles by moving vertices onto their neighbours in the order
+// of the smallest quadric error until at most target_triangles are left.
+// no vertex is moved or created, so the result indexes the same vertices.
+// vertices on open edges, which includes UV and normal seams, stay where
+// they are so the mesh does not tear. error grows by the distance the
+// result may deviate from the input.
+inline std::vector<uint32_t> simplify_triangles(const std::vector<uint32_t>& indices, const std::vector<vector3>& positions,
+												size_t target_triangles, float& error)
+{
+	size_t vertex_count = positions.size();
+	std::vector<uint32_t> triangles(indices);
+	size_t live_triangles = triangles.size() / 3;
+	std::vector<quadric> quadrics(vertex_count, quadric());
+	std::vector<std::vector<uint32_t>> vertex_triangles(vertex_count);
+
+	for (size_t t = 0; t < live_triangles; ++t)
+	{
+		const vector3& p0 = positions[triangles[t * 3]];
+		vector3 normal = cross_product(positions[triangles[t * 3 + 1]] - p0, positions[triangles[t * 3 + 2]] - p0);
+		float length = vector_length(normal);
+
+		for (int j = 0; j < 3; ++j)
+		{
+			vertex_triangles[triangles[t * 3 + j]].push_back(static_cast<uint32_t>(t));
+		}
+
+		if (length > 0.0f)
+		{
+			normal = normal * (1.0f / length);
+
+			for (int j = 0; j < 3; ++j)
+			{
+				add_plane(quadrics[triangles[t * 3 + j]], normal, -dot_product(normal, p0));
+			}
+		}
+	}
+
+	// an edge only one triangle uses is open
+	std::vector<uint64_t> edges;
+	edges.reserve(triangles.size());
+
+	for (size_t i = 0; i < triangles.size(); ++i)
+	{
+		uint64_t a = triangles[i];
+		uint64_t b = triangles[i % 3 == 2 ? i - 2 : i + 1];
+		edges.push_back(std::min(a, b) << 32 | std::max(a, b));
+	}
+
+	std::sort(edges.begin(), edges.end());
+	std::vector<bool> locked(vertex_count, false);
+
+	for (size_t i = 0; i < edges.size(); )
+	{
+		size_t j = i + 1;
+
+		while (j < edges.size() && edges[j] == edges[i])
+		{
+			++j;
+		}
+
+		if (j - i == 1)
+		{
+			locked[edges[i] >> 32] = true;
+			locked[edges[i] & 0xffffffff] = true;
+		}
+
+		i = j;
+	}
+
+	std::vector<bool> removed(live_triangles, false);
+	std::vector<bool> collapsed(vertex_count, false);
+	std::vector<uint32_t> versions(vertex_count, 0);
+	std::vector<edge_collapse> heap;
+
+	auto push_collapse = [&](uint32_t from, uint32_t to)
+	{
+		if (!locked[from])
+		{
+			quadric q = quadrics[from];
+			add_quadric(q, quadrics[to]);
+			edge_collapse c = {quadric_error(q, positions[to]), from, to, versions[from], versions[to]};
+			heap.push_back(c);
+			std::push_heap(heap.begin(), heap.end());
+		}
+	};
+
+	for (size_t i = 0; i < triangles.size(); ++i)
+	{
+		uint32_t a = triangles[i];
+		uint32_t b = triangles[i % 3 == 2 ? i - 2 : i + 1];
+		push_collapse(a, b);
+		push_collapse(b, a);
+	}
+
+	double max_cost = 0.0;
+
+	while (live_triangles > target_triangles && !heap.empty())
+	{
+		std::pop_heap(heap.begin(), heap.end());
+		edge_collapse c = heap.back();
+		heap.pop_back();
+
+		if (collapsed[c.from] || collapsed[c.to] || versions[c.from] != c.from_version || versions[c.to] != c.to_version)
+		{
+			continue;
+		}
+
+		// moving from onto to must not turn any of the remaining triangles
+		// around
+		bool flips = false;
+
+		for (std::vector<uint32_t>::const_iterator iter = vertex_triangles[c.from].begin();
+			 iter != vertex_triangles[c.from].end() && !flips; ++iter)
+		{
+			const uint32_t* t = &triangles[*iter * 3];
+
+			if (removed[*iter] || t[0] == c.to || t[1] == c.to || t[2] == c.to)
+			{
+				continue;
+			}
+
+			vector3 p[3] = {positions[t[0]], positions[t[1]], positions[t[2]]};
+			vector3 before = cross_product(p[1] - p[0], p[2] - p[0]);
+
+			for (int j = 0; j < 3; ++j)
+			{
+				if (t[j] == c.from)
+				{
+					p[j] = positions[c.to];
+				}
+			}
+
+			flips = dot_product(before, cross_product(p[1] - p[0], p[2] - p[0])) <= 0.0f;
+		}
+
+		if (flips)
+		{
+			continue;
+		}
+
+		for (std::vector<uint32_t>::const_iterator iter = vertex_triangles[c.from].begin(); iter != vertex_triangles[c.from].end(); ++iter)
+		{
+			uint32_t* t = &triangles[*iter * 3];
+
+			if (removed[*iter])
+			{
+				continue;
+			}
+
+			if (t[0] == c.to || t[1] == c.to || t[2] == c.to)
+			{
+				removed[*iter] = true;
+				--live_triangles;
+				continue;
+			}
+
+			for (int j = 0; j < 3; ++j)
+			{
+				if (t[j] == c.from)
+				{
+					t[j] = c.to;
+				}
+			}
+
+			vertex_triangles[c.to].push_back(*iter);
+		}
+
+		collapsed[c.from] = true;
+		add_quadric(quadrics[c.to], quadrics[c.from]);
+		++versions[c.to];
+		max_cost = std::max(max_cost, c.cost);
+
+		for (std::vector<uint32_t>::const_iterator iter = vertex_triangles[c.to].begin(); iter != vertex_triangles[c.to].end(); ++iter)
+		{
+			if (removed[*iter])
+			{
+				continue;
+			}
+
+			for (int j = 0; j < 3; ++j)
+			{
+				uint32_t v = triangles[*iter * 3 + j];
+
+				if (v != c.to)
+				{
+					push_collapse(c.to, v);
+					push_collapse(v, c.to);
+				}
+			}
+		}
+	}
+
+	std::vector<uint32_t> ret;
+	ret.reserve(live_triangles * 3);
+
+	for (size_t t = 0; t < removed.size(); ++t)
+	{
+		if (!removed[t])
+		{
+			ret.insert(ret.end(), triangles.begin() + t * 3, triangles.begin() + t * 3 + 3);
+		}
+	}
+
+	error += static_cast<float>(std::sqrt(max_cost));
+	return ret;
+}
+
+// one level of detail, a range of the index buffer of its mesh. error is
+// how far in model units it may deviate from the full mesh.
+struct mesh_lod
+{
+	uint32_t first_index;
+	uint32_t index_count;
+	float error;
+};
+
+const int max_lod_count = 4;
+// meshes are not simplified below this
+const size_t min_lod_triangles = 64;
+
+// the index buffer of m with all levels of detail back to back: the full
+// mesh first, then up to max_lod_count - 1 levels with about half the
+// triangles of the previous one each. every level is ordered for the vertex
+// cache, remap receives the new index of every vertex as from
+// optimize_vertex_fetch.
+inline std::vector<uint32_t> optimize_assimp_mesh(const aiMesh* m, std::vector<uint32_t>& remap, std::vector<mesh_lod>& lods)
+{
+	std::vector<std::vector<uint32_t>> levels(1, read_assimp_triangles(m));
+	std::vector<float> errors(1, 0.0f);
+	std::vector<vector3> positions;
+	positions.reserve(m->mNumVertices);
+
+	for (unsigned i = 0; i < m->mNumVertices; ++i)
+	{
+		positions.push_back(vector3(m->mVertices[i].x, m->mVertices[i].y, m->mVertices[i].z));
+	}
+
+	while (levels.size() < size_t(max_lod_count) && levels.back().size() / 3 >= 2 * min_lod_triangles)
+	{
+		float error = errors.back();
+		std::vector<uint32_t> level = simplify_triangles(levels.back(), positions, levels.back().size() / 6, error);
+
+		// stuck on locked vertices, another level would barely be cheaper
+		if (level.size() * 4 > levels.back().size() * 3)
+		{
+			break;
+		}
+
+		levels.push_back(level);
+		errors.push_back(error);
+	}
+
+	for (std::vector<std::vector<uint32_t>>::iterator iter = levels.begin(); iter != levels.end(); ++iter)
+	{
+		optimize_vertex_cache(*iter, m->mNumVertices);
+	}
+
+	remap = optimize_vertex_fetch(levels[0], m->mNumVertices);
+	std::vector<uint32_t> ret(levels[0]);
+	lods.clear();
+	lods.push_back(mesh_lod{0, static_cast<uint32_t>(ret.size()), 0.0f});
+
+	for (size_t i = 1; i < levels.size(); ++i)
+	{
+		lods.push_back(mesh_lod{static_cast<uint32_t>(ret.size()), static_cast<uint32_t>(levels[i].size()), errors[i]});
+
+		for (std::vector<uint32_t>::const_iterator iter = levels[i].begin(); iter != levels[i].end(); ++iter)
+		{
+			ret.push_back(remap[*iter]);
+		}
+	}
+
+	return ret;
+}
+
+template <typename T>
+void pack_indices(const std::vector<uint32_t>& indices, T* out)
+{
+	for (std::vector<uint32_t>::const_iterator iter = indices.begin(); iter != indices.end(); ++iter)
+	{
+		*out++ = static_cast<T>(*iter);
+	}
+}
+
+// writes indices with index_size bytes each
+inline void pack_indices(const std::vector<uint32_t>& indices, uint8_t* out, int index_size)
+{
+	switch (index_size)
+	{
+	case 1:
+		pack_indices(indices, out);
+		break;
+	case 2:
+		pack_indices(indices, reinterpret_cast<uint16_t*>(out));
+		break;
+	default:
+		pack_indices(indices, reinterpret_cast<uint32_t*>(out));
+		break;
+	}
+}
+
+// index i of indices with index_size bytes each
+inline uint32_t read_index(const uint8_t* indices, int index_size, size_t i)
+{
+	switch (index_size)
+	{
+	case 1:
+		return indices[i];
+	case 2:
+		return reinterpret_cast<const uint16_t*>(indices)[i];
+	default:
+		return reinterpret_cast<const uint32_t*>(indices)[i];
+	}
+}
+
+// offsets are relative to the start of the file, map_cooked_model replaces
+// them in place by pointers into the mapping. an offset of 0 is a null
+// pointer, the header is always at offset 0.
+template <typename T>
+union cooked_ptr
+{
+	uint64_t offset;
+	T* ptr;
+};
+
+static_assert(sizeof(cooked_ptr<char>) == 8, "cooked pointers must be 64 bit");
+
+struct cooked_vector_key
+{
+	double time;
+	vector3 value;
+};
+
+struct cooked_quat_key
+{
+	double time;
+	quaternion value;
+};
+
+struct cooked_channel
+{
+	cooked_ptr<const char> node_ref;
+	cooked_ptr<cooked_vector_key> pos_keys;
+	cooked_ptr<cooked_quat_key> rot_keys;
+	cooked_ptr<cooked_vector_key> scale_keys;
+	uint32_t pos_key_count;
+	uint32_t rot_key_count;
+	uint32_t scale_key_count;
+};
+
+struct cooked_animation
+{
+	cooked_ptr<const char> name;
+	cooked_ptr<cooked_channel> channels;
+	double ticks_per_second;
+	uint32_t channel_count;
+};
+
+struct cooked_influence
+{
+	int32_t vertex;
+	float weight;
+};
+
+struct cooked_bone
+{
+	cooked_ptr<const char> node_ref;
+	cooked_ptr<cooked_influence> influences;
+	matrix4 offset;
+	uint32_t influence_count;
+};
+
+struct cooked_material
+{
+	// null if the material has no diffuse texture
+	cooked_ptr<const char> texture_path;
+	float diffuse[4];
+	float emissive[4];
+	float ambient[4];
+	float specular[4];
+	float shininess;
+};
+
+// vertex and index data are ready to be handed to glBufferData
+struct cooked_mesh
+{
+	cooked_ptr<uint8_t> vertices;
+	cooked_ptr<uint8_t> indices;
+	cooked_ptr<cooked_bone> bones;
+	// ranges of indices, the full mesh first
+	cooked_ptr<mesh_lod> lods;
+	vertex_layout layout;
+	uint32_t vertex_count;
+	// of all levels of detail together
+	uint32_t index_count;
+	// 1, 2 or 4 bytes, see index_size_for
+	uint32_t index_size;
+	uint32_t bone_count;
+	uint32_t lod_count;
+	uint32_t material;
+};
+
+// nodes are stored in depth first order, the root is the first one
+struct cooked_node
+{
+	cooked_ptr<const char> name;
+	cooked_ptr<uint32_t> meshes;
+	matrix4 transform;
+	int32_t first_child;
+	int32_t next_sibling;
+	uint32_t mesh_count;
+};
+
+const uint32_t cooked_model_magic = 0x4b4f4f43; // "COOK"
+const uint32_t cooked_model_version = 7;
+
+// the layout is the native one of the machine that cooked the file, the
+// version has to be bumped whenever one of the structs above changes
+struct cooked_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t file_size;
+	cooked_ptr<cooked_node> nodes;
+	cooked_ptr<cooked_mesh> meshes;
+	cooked_ptr<cooked_material> materials;
+	cooked_ptr<cooked_animation> animations;
+	matrix4 global_inverse;
+	double ticks_per_second;
+	// content hash of whatever the file was cooked from, 0 if unknown
+	uint64_t source_hash;
+	uint32_t node_count;
+	uint32_t mesh_count;
+	uint32_t material_count;
+	uint32_t animation_count;
+};
+
+inline void read_assimp_color(const aiMaterial* mat, const char* key, unsigned type, unsigned index, float* out)
+{
+	aiColor3D color(0.0f, 0.0f, 0.0f);
+	mat->Get(key, type, index, color);
+	out[0] = color.r;
+	out[1] = color.g;
+	out[2] = color.b;
+	out[3] = 1.0f;
+}
+
+// fills everything but the texture path, which is returned instead
+inline std::string read_assimp_material(const aiMaterial* assimp_mat, cooked_material& mat)
+{
+	read_assimp_color(assimp_mat, AI_MATKEY_COLOR_DIFFUSE, mat.diffuse);
+	read_assimp_color(assimp_mat, AI_MATKEY_COLOR_EMISSIVE, mat.emissive);
+	read_assimp_color(assimp_mat, AI_MATKEY_COLOR_AMBIENT, mat.ambient);
+	read_assimp_color(assimp_mat, AI_MATKEY_COLOR_SPECULAR, mat.specular);
+
+	mat.shininess = 0.0f;
+	assimp_mat->Get(AI_MATKEY_SHININESS, mat.shininess);
+
+	// like the runtime, the last diffuse texture wins
+	std::string texture_path;
+
+	for (unsigned i = 0; i < assimp_mat->GetTextureCount(aiTextureType_DIFFUSE); ++i)
+	{
+		aiString path;
+		assimp_mat->Get(AI_MATKEY_TEXTURE(aiTextureType_DIFFUSE, i), path);
+		texture_path = path.C_Str();
+	}
+
+	return texture_path;
+}
+
+// appends aligned, zero initialized records to a growing byte buffer, records
+// are addressed by offset since the buffer moves while it grows
+class cooked_writer
+{
+public:
+	template <typename T>
+	uint64_t reserve(size_t count, size_t alignment = 16)
+	{
+		size_t offset = (data.size() + alignment - 1) & ~(alignment - 1);
+		data.resize(offset + count * sizeof(T), 0);
+		return offset;
+	}
+
+	template <typename T>
+	T& at(uint64_t offset, size_t index = 0)
+	{
+		return reinterpret_cast<T*>(data.data() + offset)[index];
+	}
+
+	uint64_t write_bytes(const void* bytes, size_t size, size_t alignment = 16)
+	{
+		uint64_t offset = reserve<uint8_t>(size, alignment);
+		std::memcpy(data.data() + offset, bytes, size);
+		return offset;
+	}
+
+	uint64_t write_string(const char* str)
+	{
+		return write_bytes(str, std::strlen(str) + 1, 1);
+	}
+
+	std::vector<uint8_t> data;
+};
+
+inline int32_t cook_node(cooked_writer& w, uint64_t nodes, int32_t& next_index, const aiNode* node)
+{
+	int32_t index = next_index++;
+	int32_t prev_child = -1;
+
+	for (unsigned i = 0; i < node->mNumChildren; ++i)
+	{
+		int32_t child = cook_node(w, nodes, next_index, node->mChildren[i]);
+
+		if (prev_child < 0)
+		{
+			w.at<cooked_node>(nodes, index).first_child = child;
+		}
+		else
+		{
+			w.at<cooked_node>(nodes, prev_child).next_sibling = child;
+		}
+
+		prev_child = child;
+	}
+
+	uint64_t name = w.write_string(node->mName.C_Str());
+	uint64_t meshes = node->mNumMeshes > 0 ? w.write_bytes(node->mMeshes, node->mNumMeshes * sizeof(uint32_t), 4) : 0;
+
+	cooked_node& n = w.at<cooked_node>(nodes, index);
+	n.name.offset = name;
+	n.meshes.offset = meshes;
+	n.mesh_count = node->mNumMeshes;
+	n.transform = convert_assimp_matrix(node->mTransformation);
+
+	return index;
+}
+
+inline unsigned count_assimp_nodes(const aiNode* node)
+{
+	unsigned ret = 1;
+
+	for (unsigned i = 0; i < node->mNumChildren; ++i)
+	{
+		ret += count_assimp_nodes(node->mChildren[i]);
+	}
+
+	return ret;
+}
+
+inline std::vector<cooked_vector_key> read_assimp_keys(const aiVectorKey* keys, unsigned count)
+{
+	std::vector<cooked_vector_key> ret(count);
+
+	for (unsigned i = 0; i < count; ++i)
+	{
+		ret[i].time = keys[i].mTime;
+		ret[i].value = vector3(keys[i].mValue.x, keys[i].mValue.y, keys[i].mValue.z);
+	}
+
+	return ret;
+}
+
+inline std::vector<cooked_quat_key> read_assimp_keys(const aiQuatKey* keys, unsigned count)
+{
+	std::vector<cooked_quat_key> ret(count);
+
+	for (unsigned i = 0; i < count; ++i)
+	{
+		ret[i].time = keys[i].mTime;
+		ret[i].value = quaternion(keys[i].mValue.w, keys[i].mValue.x, keys[i].mValue.y, keys[i].mValue.z);
+	}
+
+	return ret;
+}
+
+inline vector3 interpolate_key(const vector3& v, const vector3& w, double lerp)
+{
+	return linear_interpolation(v, w, lerp);
+}
+
+// the slerp animation playback uses, so dropped keys are reproduced within
+// the tolerance at runtime too
+inline quaternion interpolate_key(const quaternion& q1, const quaternion& q2, double lerp)
+{
+	return spherical_linear_interpolation(q1, q2, static_cast<float>(lerp));
+}
+
+// largest difference of a component, in model units
+inline float key_error(const vector3& v, const vector3& w)
+{
+	return std::max(std::fabs(v.x - w.x), std::max(std::fabs(v.y - w.y), std::fabs(v.z - w.z)));
+}
+
+// angle between the two rotations, in radians
+inline float key_error(const quaternion& q1, const quaternion& q2)
+{
+	double length = abs_quaternion(q1) * abs_quaternion(q2);
+	double cos_half_angle = length > 0.0 ? std::fabs(quaternion_dot_product(q1, q2)) / length : 1.0;
+	return 2.0 * std::acos(std::min(1.0, cos_half_angle));
+}
+
+// drops every key that interpolating between the surrounding kept keys
+// reproduces within tolerance. the first and the last key are always kept,
+// the runtime ignores channels with fewer than two keys.
+template <typename K>
+std::vector<K> reduce_keys(const std::vector<K>& keys, float tolerance)
+{
+	if (keys.size() < 3 || tolerance <= 0.0f)
+	{
+		return keys;
+	}
+
+	std::vector<K> ret(1, keys.front());
+	size_t last_kept = 0;
+
+	for (size_t i = 1; i + 1 < keys.size(); ++i)
+	{
+		const K& from = keys[last_kept];
+		const K& to = keys[i + 1];
+		bool removable = to.time > from.time;
+
+		// removing key i must not break any of the keys dropped before it
+		for (size_t j = last_kept + 1; removable && j <= i; ++j)
+		{
+			double lerp = (keys[j].time - from.time) / (to.time - from.time);
+			removable = key_error(interpolate_key(from.value, to.value, lerp), keys[j].value) <= tolerance;
+		}
+
+		if (!removable)
+		{
+			ret.push_back(keys[i]);
+			last_kept = i;
+		}
+	}
+
+	ret.push_back(keys.back());
+	return ret;
+}
+
+template <typename K>
+uint64_t write_keys(cooked_writer& w, const std::vector<K>& keys)
+{
+	return keys.empty() ? 0 : w.write_bytes(keys.data(), keys.size() * sizeof(K));
+}
+
+// processing that is too slow to do on every load, the defaults keep the
+// scene exactly as the importer returned it
+struct cook_options
+{
+	// keys that interpolating their neighbours reproduces within this
+	// tolerance are dropped, 0 keeps all keys. model units for positions and
+	// scalings, radians for rotations.
+	float key_tolerance = 0.0f;
+	// scales the bone weights of every vertex so they sum up to 1
+	bool normalize_weights = false;
+	// what the vertices store, see choose_vertex_layout
+	unsigned vertex_attributes = default_vertex_attributes;
+	// stored in the header, see cooked_header::source_hash
+	uint64_t source_hash = 0;
+};
+
+// what cook_scene did to a mesh, for reporting
+struct cooked_mesh_stats
+{
+	// of the full mesh, see average_cache_miss_ratio
+	float acmr_before;
+	float acmr_after;
+	std::vector<uint32_t> triangles_per_lod;
+};
+
+// turns an imported scene into the cooked format, the result can be written
+// to disk as is. stats, if given, gets one entry per mesh of scene.
+inline std::vector<uint8_t> cook_scene(const aiScene* scene, const cook_options& options = cook_options(),
+									   std::vector<cooked_mesh_stats>* stats = nullptr)
+{
+	cooked_writer w;
+	uint64_t header = w.reserve<cooked_header>(1);
+
+	unsigned node_count = count_assimp_nodes(scene->mRootNode);
+	uint64_t nodes = w.reserve<cooked_node>(node_count);
+
+	for (unsigned i = 0; i < node_count; ++i)
+	{
+		w.at<cooked_node>(nodes, i).first_child = -1;
+		w.at<cooked_node>(nodes, i).next_sibling = -1;
+	}
+
+	int32_t next_index = 0;
+	cook_node(w, nodes, next_index, scene->mRootNode);
+
+	uint64_t materials = w.reserve<cooked_material>(scene->mNumMaterials);
+
+	for (unsigned i = 0; i < scene->mNumMaterials; ++i)
+	{
+		cooked_material mat;
+		std::string texture_path = read_assimp_material(scene->mMaterials[i], mat);
+		mat.texture_path.offset = texture_path.empty() ? 0 : w.write_string(texture_path.c_str());
+		w.at<cooked_material>(materials, i) = mat;
+	}
+
+	uint64_t meshes = w.reserve<cooked_mesh>(scene->mNumMeshes);
+	std::vector<std::vector<uint32_t>> mesh_indices(scene->mNumMeshes);
+	std::vector<std::vector<uint32_t>> remaps(scene->mNumMeshes);
+
+	for (unsigned i = 0; i < scene->mNumMeshes; ++i)
+	{
+		const aiMesh* m = scene->mMeshes[i];
+		std::vector<mesh_lod> lods;
+		mesh_indices[i] = optimize_assimp_mesh(m, remaps[i], lods);
+
+		if (stats != nullptr)
+		{
+			cooked_mesh_stats mesh_stats;
+			mesh_stats.acmr_before = average_cache_miss_ratio(read_assimp_triangles(m));
+			mesh_stats.acmr_after = average_cache_miss_ratio(std::vector<uint32_t>(mesh_indices[i].begin(), mesh_indices[i].begin() + lods[0].index_count));
+
+			for (std::vector<mesh_lod>::const_iterator iter = lods.begin(); iter != lods.end(); ++iter)
+			{
+				mesh_stats.triangles_per_lod.push_back(iter->index_count / 3);
+			}
+
+			stats->push_back(mesh_stats);
+		}
+		uint64_t lod_offset = w.write_bytes(lods.data(), lods.size() * sizeof(mesh_lod));
+		uint64_t bones = w.reserve<cooked_bone>(m->mNumBones);
+		std::vector<float> weight_sums(options.normalize_weights ? m->mNumVertices : 0, 0.0f);
+
+		if (!weight_sums.empty())
+		{
+			for (unsigned j = 0; j < m->mNumBones; ++j)
+			{
+				for (unsigned k = 0; k < m->mBones[j]->mNumWeights; ++k)
+				{
+					weight_sums[m->mBones[j]->mWeights[k].mVertexId] += m->mBones[j]->mWeights[k].mWeight;
+				}
+			}
+		}
+
+		for (unsigned j = 0; j < m->mNumBones; ++j)
+		{
+			const aiBone* b = m->mBones[j];
+			uint64_t node_ref = w.write_string(b->mName.C_Str());
+			uint64_t influences = w.reserve<cooked_influence>(b->mNumWeights);
+
+			for (unsigned k = 0; k < b->mNumWeights; ++k)
+			{
+				float weight = b->mWeights[k].mWeight;
+
+				if (!weight_sums.empty() && weight_sums[b->mWeights[k].mVertexId] > 0.0f)
+				{
+					weight /= weight_sums[b->mWeights[k].mVertexId];
+				}
+
+				w.at<cooked_influence>(influences, k).vertex = remaps[i][b->mWeights[k].mVertexId];
+				w.at<cooked_influence>(influences, k).weight = weight;
+			}
+
+			cooked_bone& cb = w.at<cooked_bone>(bones, j);
+			cb.node_ref.offset = node_ref;
+			cb.influences.offset = influences;
+			cb.influence_count = b->mNumWeights;
+			cb.offset = convert_assimp_matrix(b->mOffsetMatrix);
+		}
+
+		cooked_mesh& cm = w.at<cooked_mesh>(meshes, i);
+		cm.bones.offset = bones;
+		cm.bone_count = m->mNumBones;
+		cm.lods.offset = lod_offset;
+		cm.lod_count = lods.size();
+		cm.vertex_count = m->mNumVertices;
+		cm.layout = choose_vertex_layout(scene, m, options.vertex_attributes);
+		cm.index_count = mesh_indices[i].size();
+		cm.index_size = index_size_for(m->mNumVertices);
+		cm.material = m->mMaterialIndex;
+	}
+
+	uint64_t animations = w.reserve<cooked_animation>(scene->mNumAnimations);
+	double ticks_per_second = 0.0;
+
+	for (unsigned i = 0; i < scene->mNumAnimations; ++i)
+	{
+		const aiAnimation* anim = scene->mAnimations[i];
+		uint64_t name = w.write_string(anim->mName.C_Str());
+		uint64_t channels = w.reserve<cooked_channel>(anim->mNumChannels);
+
+		for (unsigned j = 0; j < anim->mNumChannels; ++j)
+		{
+			const aiNodeAnim* channel = anim->mChannels[j];
+			uint64_t node_ref = w.write_string(channel->mNodeName.C_Str());
+			std::vector<cooked_vector_key> pos_keys = reduce_keys(read_assimp_keys(channel->mPositionKeys, channel->mNumPositionKeys), options.key_tolerance);
+			std::vector<cooked_quat_key> rot_keys = reduce_keys(read_assimp_keys(channel->mRotationKeys, channel->mNumRotationKeys), options.key_tolerance);
+			std::vector<cooked_vector_key> scale_keys = reduce_keys(read_assimp_keys(channel->mScalingKeys, channel->mNumScalingKeys), options.key_tolerance);
+
+			uint64_t pos_offset = write_keys(w, pos_keys);
+			uint64_t rot_offset = write_keys(w, rot_keys);
+			uint64_t scale_offset = write_keys(w, scale_keys);
+
+			cooked_channel& c = w.at<cooked_channel>(channels, j);
+			c.node_ref.offset = node_ref;
+			c.pos_keys.offset = pos_offset;
+			c.pos_key_count = pos_keys.size();
+			c.rot_keys.offset = rot_offset;
+			c.rot_key_count = rot_keys.size();
+			c.scale_keys.offset = scale_offset;
+			c.scale_key_count = scale_keys.size();
+		}
+
+		cooked_animation& a = w.at<cooked_animation>(animations, i);
+		a.name.offset = name;
+		a.channels.offset = channels;
+		a.channel_count = anim->mNumChannels;
+		a.ticks_per_second = anim->mTicksPerSecond;
+		ticks_per_second = anim->mTicksPerSecond;
+	}
+
+	// the vertex and index blobs go last. only the vertex blobs are page
+	// aligned, but that puts all blobs past the pages of the tables in front
+	// of them, so fixing up the tables does not copy any of their pages
+	for (unsigned i = 0; i < scene->mNumMeshes; ++i)
+	{
+		const aiMesh* m = scene->mMeshes[i];
+		vertex_layout layout = w.at<cooked_mesh>(meshes, i).layout;
+		uint64_t vertices = w.reserve<uint8_t>(m->mNumVertices * layout.size, 4096);
+		pack_assimp_vertices(m, layout, &w.at<uint8_t>(vertices), remaps[i].data());
+		int index_size = index_size_for(m->mNumVertices);
+		uint64_t indices = w.reserve<uint8_t>(mesh_indices[i].size() * index_size);
+		pack_indices(mesh_indices[i], &w.at<uint8_t>(indices), index_size);
+
+		w.at<cooked_mesh>(meshes, i).vertices.offset = vertices;
+		w.at<cooked_mesh>(meshes, i).indices.offset = indices;
+	}
+
+	// Inverse() works in place, so invert a copy
+	aiMatrix4x4 global_inverse = scene->mRootNode->mTransformation;
+	global_inverse.Inverse();
+
+	cooked_header& h = w.at<cooked_header>(header);
+	h.magic = cooked_model_magic;
+	h.version = cooked_model_version;
+	h.file_size = w.data.size();
+	h.nodes.offset = nodes;
+	h.node_count = node_count;
+	h.meshes.offset = meshes;
+	h.mesh_count = scene->mNumMeshes;
+	h.materials.offset = materials;
+	h.material_count = scene->mNumMaterials;
+	h.animations.offset = animations;
+	h.animation_count = scene->mNumAnimations;
+	h.global_inverse = convert_assimp_matrix(global_inverse);
+	h.ticks_per_second = ticks_per_second;
+	h.source_hash = options.source_hash;
+
+	return w.data;
+}
+
+inline bool write_cooked_file(const char* path, const std::vector<uint8_t>& data)
+{
+	FILE* out = fopen(path, "wb");
+
+	if (out == nullptr)
+	{
+		return false;
+	}
+
+	bool ok = fwrite(data.data(), 1, data.size(), out) == data.size();
+	return fclose(out) == 0 && ok;
+}
+
+// reads just the header of a cooked file, returns false if there is none or
+// it was written by a different version
+inline bool read_cooked_header(const char* path, cooked_header& header)
+{
+	FILE* in = fopen(path, "rb");
+
+	if (in == nullptr)
+	{
+		return false;
+	}
+
+	bool ok = fread(&header, sizeof(header), 1, in) == 1;
+	fclose(in);
+	return ok && header.magic == cooked_model_magic && header.version == cooked_model_version;
+}
+
+// 64 bit FNV-1a, chain calls by passing the previous result as hash
+inline uint64_t hash_bytes(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+// private, writable mapping of a whole file. pages are only copied when
+// they are written to, which for cooked models are just the tables.
+class mapped_file
+{
+public:
+	explicit mapped_file(const char* path)
+	{
+		int fd = open(path, O_RDONLY);
+
+		if (fd < 0)
+		{
+			return;
+		}
+
+		struct stat st;
+
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			void* mapping = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+			if (mapping != MAP_FAILED)
+			{
+				data = static_cast<uint8_t*>(mapping);
+				size = st.st_size;
+			}
+		}
+
+		close(fd);
+	}
+
+	mapped_file(const mapped_file& ) = delete;
+	mapped_file& operator=(const mapped_file& ) = delete;
+	mapped_file(mapped_file&& ) = delete;
+	mapped_file& operator=(mapped_file&& ) = delete;
+
+	~mapped_file()
+	{
+		if (data != nullptr)
+		{
+			munmap(data, size);
+		}
+	}
+
+	uint8_t* data = nullptr;
+	size_t size = 0;
+};
+
+// content hash of a whole file, fails for missing and empty files
+inline bool hash_file(const char* path, uint64_t& hash)
+{
+	mapped_file file(path);
+
+	if (file.data == nullptr)
+	{
+		return false;
+	}
+
+	hash = hash_bytes(file.data, file.size);
+	return true;
+}
+
+// turns the offset in p into a pointer, fails if count elements starting
+// there would not lie inside the file
+template <typename T>
+bool fix_up(cooked_ptr<T>& p, size_t count, const mapped_file& file)
+{
+	if (p.offset == 0)
+	{
+		p.ptr = nullptr;
+		return count == 0;
+	}
+
+	if (p.offset % alignof(T) != 0 || p.offset > file.size || count > (file.size - p.offset) / sizeof(T))
+	{
+		return false;
+	}
+
+	p.ptr = reinterpret_cast<T*>(file.data + p.offset);
+	return true;
+}
+
+// count elements of size bytes, fails if that does not fit in size_t.
+// both are 32 bit values, so the product does not overflow 64 bits.
+inline bool byte_count(uint64_t count, uint64_t size, size_t& bytes)
+{
+	uint64_t ret = count * size;
+
+	if (ret > SIZE_MAX)
+	{
+		return false;
+	}
+
+	bytes = static_cast<size_t>(ret);
+	return true;
+}
+
+inline bool fix_up_string(cooked_ptr<const char>& p, const mapped_file& file)
+{
+	if (p.offset == 0 || p.offset >= file.size ||
+		std::memchr(file.data + p.offset, 0, file.size - p.offset) == nullptr)
+	{
+		return false;
+	}
+
+	p.ptr = reinterpret_cast<const char*>(file.data + p.offset);
+	return true;
+}
+
+// checks the header and replaces all offsets in the mapped file by
+// pointers. returns nullptr if the file is not a valid cooked model.
+inline const cooked_header* map_cooked_model(mapped_file& file)
+{
+	if (file.data == nullptr || file.size < sizeof(cooked_header))
+	{
+		return nullptr;
+	}
+
+	cooked_header* h = reinterpret_cast<cooked_header*>(file.data);
+
+	if (h->magic != cooked_model_magic || h->version != cooked_model_version || h->file_size != file.size)
+	{
+		return nullptr;
+	}
+
+	bool ok = fix_up(h->nodes, h->node_count, file) && h->node_count > 0 &&
+			  fix_up(h->meshes, h->mesh_count, file) &&
+			  fix_up(h->materials, h->material_count, file) &&
+			  fix_up(h->animations, h->animation_count, file);
+
+	for (uint32_t i = 0; ok && i < h->node_count; ++i)
+	{
+		cooked_node& n = h->nodes.ptr[i];
+		// children and siblings always come later in depth first order,
+		// which also rules out cycles
+		ok = fix_up_string(n.name, file) && fix_up(n.meshes, n.mesh_count, file) &&
+			 (n.first_child == -1 || (n.first_child > int32_t(i) && n.first_child < int32_t(h->node_count))) &&
+			 (n.next_sibling == -1 || (n.next_sibling > int32_t(i) && n.next_sibling < int32_t(h->node_count)));
+
+		for (uint32_t j = 0; ok && j < n.mesh_count; ++j)
+		{
+			ok = n.meshes.ptr[j] < h->mesh_count;
+		}
+	}
+
+	for (uint32_t i = 0; ok && i < h->material_count; ++i)
+	{
+		cooked_material& m = h->materials.ptr[i];
+		ok = m.texture_path.offset == 0 || fix_up_string(m.texture_path, file);
+	}
+
+	for (uint32_t i = 0; ok && i < h->mesh_count; ++i)
+	{
+		cooked_mesh& m = h->meshes.ptr[i];
+		size_t vertex_bytes = 0;
+		size_t index_bytes = 0;
+		ok = valid_vertex_layout(m.layout) && (m.index_size == 1 || m.index_size == 2 || m.index_size == 4) &&
+			 m.indices.offset % m.index_size == 0 &&
+			 byte_count(m.vertex_count, static_cast<uint32_t>(m.layout.size), vertex_bytes) &&
+			 byte_count(m.index_count, m.index_size, index_bytes) &&
+			 fix_up(m.vertices, vertex_bytes, file) && fix_up(m.indices, index_bytes, file) &&
+			 fix_up(m.bones, m.bone_count, file) && fix_up(m.lods, m.lod_count, file) && m.lod_count > 0 &&
+			 (m.material < h->material_count || m.vertex_count == 0);
+
+		// every level of detail is a range of these, so this covers them all
+		for (uint32_t j = 0; ok && j < m.index_count; ++j)
+		{
+			ok = read_index(m.indices.ptr, static_cast<int>(m.index_size), j) < m.vertex_count;
+		}
+
+		for (uint32_t j = 0; ok && j < m.lod_count; ++j)
+		{
+			ok = m.lods.ptr[j].first_index <= m.index_count && m.lods.ptr[j].index_count <= m.index_count - m.lods.ptr[j].first_index;
+		}
+
+		for (uint32_t j = 0; ok && j < m.bone_count; ++j)
+		{
+			cooked_bone& b = m.bones.ptr[j];
+			ok = fix_up_string(b.node_ref, file) && fix_up(b.influences, b.influence_count, file);
+
+			// skinning writes to the vertices the influences name
+			for (uint32_t k = 0; ok && k < b.influence_count; ++k)
+			{
+				ok = b.influences.ptr[k].vertex >= 0 && uint32_t(b.influences.ptr[k].vertex) < m.vertex_count;
+			}
+		}
+	}
+
+	for (uint32_t i = 0; ok && i < h->animation_count; ++i)
+	{
+		cooked_animation& a = h->animations.ptr[i];
+		ok = fix_up_string(a.name, file) && fix_up(a.channels, a.channel_count, file);
+
+		for (uint32_t j = 0; ok && j < a.channel_count; ++j)
+		{
+			cooked_channel& c = a.channels.ptr[j];
+			ok = fix_up_string(c.node_ref, file) && fix_up(c.pos_keys, c.pos_key_count, file) &&
+				 fix_up(c.rot_keys, c.rot_key_count, file) && fix_up(c.scale_keys, c.scale_key_count, file);
+		}
+	}
+
+	return ok ? h : nullptr;
+}
+
+#endif
@@ -1,6 +1,28 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include <dirent.h>
 
 #include <GL/glew.h>
 
@@ -17,233 +39,153 @@
 
 #include "stb_image.h"
 
+#include "arena.h"
+#include "bvh.h"
+#include "cooked_model.h"
+#include "occlusion.h"
+#include "vector_math.h"
+
 using namespace std;
 
-struct vector3
+// fixed set of threads for fork/join style parallel loops. the calling
+// thread takes part in the work, so parallel_for may be nested in tasks.
+class worker_pool
 {
-	vector3()
-		: x(0.0f), y(0.0f), z(0.0f)
-	{
-
-	}
-
-	vector3(float x, float y, float z)
-		: x(x), y(y), z(z)
+public:
+	// thread_cnt includes the calling thread, 1 runs everything inline
+	explicit worker_pool(int thread_cnt)
 	{
-
+		for (int i = 1; i < thread_cnt; ++i)
+		{
+			threads.push_back(std::thread(&worker_pool::work, this));
+		}
 	}
 
-	float x, y, z;
-};
-
-vector3 linear_interpolation(const vector3& v, const vector3& w, double lerp)
-{
-	return vector3((1 - lerp) * v.x + lerp * w.x, (1 - lerp) * v.y + lerp * w.y, (1 - lerp) * v.z + lerp * w.z);
-}
+	worker_pool(const worker_pool& ) = delete;
+	worker_pool& operator=(const worker_pool& ) = delete;
+	worker_pool(worker_pool&& ) = delete;
+	worker_pool& operator=(worker_pool&& ) = delete;
 
-struct quaternion
-{
-	quaternion()
+	~worker_pool()
 	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
 
-	}
-
-	quaternion(float w, float x, float y, float z)
-		: w(w), x(x), y(y), z(z)
-	{
+		work_available.notify_all();
 
+		for (std::vector<std::thread>::iterator iter = threads.begin(); iter != threads.end(); ++iter)
+		{
+			iter->join();
+		}
 	}
 
-	float w = 0.0f;
-	float x = 0.0f;
-	float y = 0.0f;
-	float z = 0.0f;
-};
-
-double quaternion_dot_product(const quaternion& q1, const quaternion& q2)
-{
-	float ret =  q1.w * q2.w + q1.x * q2.x + q1.y * q2.y + q1.z * q2.z;
-	return ret;
-}
-
-double abs_quaternion(const quaternion& q)
-{
-	return std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
-}
-
-quaternion operator * (const quaternion& q1, const quaternion q2)
-{
-	quaternion prod;
-	prod.w = q1.w * q2.w - q1.x * q2.x - q1.y * q2.y - q1.z * q2.z;
-	prod.x = q1.w * q2.x + q1.x * q2.w + q1.y * q2.z - q1.z * q2.y;
-	prod.y = q1.w * q2.y - q1.x * q2.z + q1.y * q2.w + q1.z * q2.x;
-	prod.z = q1.w * q2.z + q1.x * q2.y - q1.y * q2.x + q1.z * q2.w;
-	return prod;
-}
-
-quaternion spherical_linear_interpolation(const quaternion& q1, const quaternion& q2, float lerp)
-{
-	float tmp = quaternion_dot_product(q1, q2) / ((abs_quaternion(q1) * abs_quaternion(q2)));
-
-	if (tmp > 1.0f)
+	int thread_count() const
 	{
-		tmp = 1.0f;
+		return static_cast<int>(threads.size()) + 1;
 	}
 
-	float theta = std::acos(tmp);
-
-	if (theta > 0.000001f || theta < 0.000001f)
+	// calls f(i) for all i in [0, count) and returns when all calls are done
+	void parallel_for(int count, const std::function<void(int)>& f)
 	{
-		return q1;
-	}
-
-	float q1_weight = std::sin(theta * (1 - lerp)) / sin(theta);
-	float q2_weight = std::sin(theta * lerp) / sin(theta);
+		if (threads.empty() || count < 2)
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				f(i);
+			}
 
-	return quaternion( q1_weight * q1.w + q2_weight * q2.w, q1_weight * q1.x + q2_weight * q2.x,
-					   q1_weight * q1.y + q2_weight * q2.y, q1_weight * q1.z + q2_weight * q2.z);
-}
+			return;
+		}
 
-struct matrix4
-{
-	matrix4()
-	{
-		elements[0] = 0.0f;
-		elements[1] = 0.0f;
-		elements[2] = 0.0f;
-		elements[3] = 0.0f;
-		elements[4] = 0.0f;
-		elements[5] = 0.0f;
-		elements[6] = 0.0f;
-		elements[7] = 0.0f;
-		elements[8] = 0.0f;
-		elements[9] = 0.0f;
-		elements[10] = 0.0f;
-		elements[11] = 0.0f;
-		elements[12] = 0.0f;
-		elements[13] = 0.0f;
-		elements[14] = 0.0f;
-		elements[15] = 0.0f;
-	}
-	float& operator() (int i, int j)
-	{
-		return elements[i * 4 + j];
-	}
+		job j;
+		j.func = &f;
+		j.count = count;
+		j.chunk_size = std::max(1, count / (thread_count() * 4));
 
-	float operator() (int i, int j) const
-	{
-		return elements[i * 4 + j];
-	}
+		std::unique_lock<std::mutex> lock(mutex);
+		jobs.push_back(&j);
+		work_available.notify_all();
 
-	float elements[16];
-};
+		while (run_chunk(lock, &j))
+		{
 
-vector3 transform_vector(const matrix4& m, const vector3& v)
-{
-	return vector3(m(0, 0) * v.x + m(0, 1) * v.y + m(0, 2) * v.z + m(0, 3),
-				   m(1, 0) * v.x + m(1, 1) * v.y + m(1, 2) * v.z + m(1, 3),
-				   m(2, 0) * v.x + m(2, 1) * v.y + m(2, 2) * v.z + m(2, 3));
-}
+		}
 
-matrix4 operator * (const matrix4& m1, const matrix4& m2)
-{
-	matrix4 res;
+		job_finished.wait(lock, [&]() { return j.finished == j.count; });
+	}
 
-	for (int i = 0; i < 4; ++i)
+private:
+	struct job
+	{
+		const std::function<void(int)>* func = nullptr;
+		int count = 0;
+		int chunk_size = 1;
+		int next = 0;
+		int finished = 0;
+	};
+
+	// claims and runs the next chunk of j, must be called with the lock
+	// held, returns false if nothing was left to claim
+	bool run_chunk(std::unique_lock<std::mutex>& lock, job* j)
 	{
-		for (int j = 0; j < 4; ++j)
+		if (j->next >= j->count)
 		{
-			res(i, j) = m1(i, 0) * m2(0, j) + m1(i, 1) * m2(1, j) + m1(i, 2) * m2(2, j) + m1(i, 3) * m2(3, j);
+			return false;
 		}
-	}
-
-	return res;
-}
-
-matrix4 translation(const vector3& position)
-{
-	matrix4 m;
-	m(0, 0) = 1.0f;
-	m(1, 1) = 1.0f;
-	m(2, 2) = 1.0f;
-	m(3, 3) = 1.0f;
 
-	m(0, 3) = position.x;
-	m(1, 3) = position.y;
-	m(2, 3) = position.z;
+		int begin = j->next;
+		int end = std::min(j->count, begin + j->chunk_size);
+		j->next = end;
 
-	return m;
-}
+		if (j->next >= j->count)
+		{
+			jobs.erase(std::find(jobs.begin(), jobs.end(), j));
+		}
 
-matrix4 uniform_scale(float scale)
-{
-	matrix4 m;
-	m(0, 0) = scale;
-	m(1, 1) = scale;
-	m(2, 2) = scale;
-	m(3, 3) = 1.0f;
+		lock.unlock();
 
-	return m;
-}
+		for (int i = begin; i < end; ++i)
+		{
+			(*j->func)(i);
+		}
 
-matrix4 non_uniform_scale(const vector3& v)
-{
-	matrix4 m;
-	m(0, 0) = v.x;
-	m(1, 1) = v.y;
-	m(2, 2) = v.z;
-	m(3, 3) = 1.0f;
+		lock.lock();
+		j->finished += end - begin;
 
-	return m;
-}
+		if (j->finished == j->count)
+		{
+			job_finished.notify_all();
+		}
 
-matrix4 rotation(const quaternion& q)
-{
-	matrix4 ret;
+		return true;
+	}
 
-	ret(0, 0) = 1.0f - 2.0f * (q.y * q.y + q.z * q.z);
-	ret(0, 1) = 2.0f * (q.x * q.y - q.w * q.z);
-	ret(0, 2) = 2.0f * (q.x * q.z + q.w * q.y);
-	ret(0, 3) = 0.0f;
-	ret(1, 0) = 2.0f * (q.x * q.y + q.w * q.z);
-	ret(1, 1) = 1.0f - 2.0f * (q.x * q.x + q.z * q.z);
-	ret(1, 2) = 2.0f * (q.y * q.z - q.w * q.x);
-	ret(1, 3) = 0.0f;
-	ret(2, 0) = 2.0f * (q.x * q.z - q.w * q.y);
-	ret(2, 1) = 2.0f * (q.y * q.z + q.w * q.x);
-	ret(2, 2) = 1.0f - 2.0f * (q.x * q.x + q.y * q.y);
-	ret(2, 3) = 0.0f;
-	ret(3, 0) = 0.0f;
-	ret(3, 1) = 0.0f;
-	ret(3, 2) = 0.0f;
-	ret(3, 3) = 1.0f;
+	void work()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
 
-	return ret;
-}
+		while (true)
+		{
+			work_available.wait(lock, [this]() { return stopping || !jobs.empty(); });
 
-matrix4 identity()
-{
-	matrix4 ret;
+			if (stopping)
+			{
+				return;
+			}
 
-	ret(0, 0) = 1.0f;
-	ret(0, 1) = 0.0f;
-	ret(0, 2) = 0.0f;
-	ret(0, 3) = 0.0f;
-	ret(1, 0) = 0.0f;
-	ret(1, 1) = 1.0f;
-	ret(1, 2) = 0.0f;
-	ret(1, 3) = 0.0f;
-	ret(2, 0) = 0.0f;
-	ret(2, 1) = 0.0f;
-	ret(2, 2) = 1.0f;
-	ret(2, 3) = 0.0f;
-	ret(3, 0) = 0.0f;
-	ret(3, 1) = 0.0f;
-	ret(3, 2) = 0.0f;
-	ret(3, 3) = 1.0f;
+			run_chunk(lock, jobs.front());
+		}
+	}
 
-	return ret;
-}
+	std::vector<std::thread> threads;
+	std::vector<job*> jobs;
+	std::mutex mutex;
+	std::condition_variable work_available;
+	std::condition_variable job_finished;
+	bool stopping = false;
+};
 
 struct vertex
 {
@@ -267,867 +209,4617 @@ struct bone
 	matrix4 transform;
 	std::string node_ref;
 	std::vector<std::pair<int, float>> vertices;
-};
 
-class model_node;
+	// bind pose positions and weights of the influenced vertices, split
+	// into one array per axis so they can be fed to transform_vectors_weighted
+	std::vector<float> bind_x;
+	std::vector<float> bind_y;
+	std::vector<float> bind_z;
+	std::vector<float> weights;
+
+	// box around the influenced vertices in the bind pose, its corners
+	// moved by the bone transform bound them in every pose
+	vector3 bind_min;
+	vector3 bind_max;
+};
 
-class mesh
+// fills the bind pose arrays of all bones from the vertex data, bones that
+// already have them are left alone
+void gather_bind_pose(std::vector<bone>& bones, const uint8_t* vertex_data, const vertex_layout& layout)
 {
-public:
-	mesh(uint8_t* vertex_data, int vertex_cnt, int vertex_size,
-		 uint16_t* index_data, int indexCnt, int indexSize,
-		 const std::vector<bone>& bones)
-		: vertex_data(vertex_data), vertex_cnt(vertex_cnt), vertex_size(vertex_size),
-		  index_data(index_data), indexCnt(indexCnt), bones(bones)
+	for (std::vector<bone>::iterator iter = bones.begin(); iter != bones.end(); ++iter)
 	{
-		GLuint bufferNames[2];
-		glGenBuffers(2, bufferNames);
-		vertexBuffer = *bufferNames;
-		indexBuffer = *(bufferNames + 1);
-
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-		glBufferData(GL_ARRAY_BUFFER, vertex_cnt * vertex_size, vertex_data, GL_STATIC_DRAW);
+		if (iter->weights.size() == iter->vertices.size())
+		{
+			continue;
+		}
 
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		iter->bind_x.clear();
+		iter->bind_y.clear();
+		iter->bind_z.clear();
+		iter->weights.clear();
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCnt * indexSize, index_data, GL_STATIC_DRAW);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		for (std::vector<std::pair<int, float>>::iterator iter2 = iter->vertices.begin();
+			 iter2 != iter->vertices.end(); ++iter2)
+		{
+			vector3 bind_vertex = read_position(vertex_data + iter2->first * layout.size, layout);
+			iter->bind_x.push_back(bind_vertex.x);
+			iter->bind_y.push_back(bind_vertex.y);
+			iter->bind_z.push_back(bind_vertex.z);
+			iter->weights.push_back(iter2->second);
+		}
 	}
+}
 
-	mesh(const mesh& ) = delete;
-	mesh& operator=(const mesh& ) = delete;
-	mesh(mesh&& ) = delete;
-	mesh& operator=(mesh&& ) = delete;
+class model_node;
+struct scene_source;
 
-	~mesh()
-	{
-		GLuint bufferNames[2] = {vertexBuffer, indexBuffer};
-		glDeleteBuffers(2, bufferNames);
+// attribute pointers are offsets into the bound buffer
+const void* buffer_offset(int offset)
+{
+	return reinterpret_cast<const void*>(static_cast<uintptr_t>(offset));
+}
 
-		delete[] vertex_data;
-		delete[] index_data;
-	}
+// fixed function GL cannot decode octahedral normals, they are uploaded as
+// bytes of the same size instead
+vertex_layout gpu_vertex_layout(const vertex_layout& layout)
+{
+	vertex_layout ret = layout;
 
-	void render() const
+	if (ret.normal_format == format_octahedral)
 	{
-		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
-		glInterleavedArrays(GL_T2F_V3F, 0, 0);
-
-		glDrawElements(GL_TRIANGLES, indexCnt, GL_UNSIGNED_SHORT, 0);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		ret.normal_format = format_snorm8;
 	}
 
-	void update(model_node* root, const matrix4& global_inverse);
+	return ret;
+}
 
-private:
-	uint8_t* vertex_data;
-	int vertex_cnt;
-	int vertex_size;
-	uint16_t* index_data;
-	GLuint vertexBuffer;
-	GLuint indexBuffer;
-	int indexCnt;
-	std::vector<bone> bones;
-};
+// whether vertices of both layouts can be drawn with the same arrays, the
+// ranges of quantized attributes may differ
+bool same_vertex_format(const vertex_layout& a, const vertex_layout& b)
+{
+	return a.size == b.size && a.position_offset == b.position_offset && a.position_format == b.position_format &&
+		   a.uv_offset == b.uv_offset && a.uv_format == b.uv_format &&
+		   a.normal_offset == b.normal_offset && a.normal_format == b.normal_format;
+}
 
-class texture
+// GL type of indices with index_size bytes, see index_size_for
+GLenum gl_index_type(int index_size)
 {
-public:
-	texture(void* pixels, int width, int height)
+	switch (index_size)
 	{
-		glGenTextures(1, &tex);
-		glBindTexture(GL_TEXTURE_2D, tex);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glBindTexture(GL_TEXTURE_2D, 0);
+	case 1:
+		return GL_UNSIGNED_BYTE;
+	case 2:
+		return GL_UNSIGNED_SHORT;
+	default:
+		return GL_UNSIGNED_INT;
 	}
+}
 
-	texture(const texture& ) = delete;
-	texture& operator=(const texture& ) = delete;
-	texture(texture&& ) = delete;
-	texture& operator=(texture&& ) = delete;
+// GL matrices are column major, matrix4 is row major
+matrix4 gl_matrix(GLenum which)
+{
+	float m[16];
+	glGetFloatv(which, m);
+	return matrix4(m[0], m[4], m[8], m[12],
+				   m[1], m[5], m[9], m[13],
+				   m[2], m[6], m[10], m[14],
+				   m[3], m[7], m[11], m[15]);
+}
 
-	~texture()
-	{
-		glDeleteTextures(1, &tex);
-	}
+// the culling frustum of whatever is drawn with the current GL matrices,
+// in the space the modelview matrix transforms from
+frustum gl_view_frustum()
+{
+	return extract_frustum(gl_matrix(GL_PROJECTION_MATRIX) * gl_matrix(GL_MODELVIEW_MATRIX));
+}
 
-	void set()
-	{
-		glBindTexture(GL_TEXTURE_2D, tex);
-	}
+// vertex array objects hold the buffers and arrays of a mesh, so drawing it
+// is one bind. GL 3.0 has them, older drivers may have the extension.
+bool vertex_arrays_available()
+{
+	return GLEW_VERSION_3_0 || GLEW_ARB_vertex_array_object;
+}
 
-private:
-	GLuint tex;
+// meshes suballocated from shared buffers are drawn with a base vertex, GL
+// 3.2 has it along with the multi-draw variant
+bool base_vertex_available()
+{
+	return GLEW_VERSION_3_2 || GLEW_ARB_draw_elements_base_vertex;
+}
+
+// multi-draws read from a buffer, GL 4.3 has them
+bool indirect_draw_available()
+{
+	return GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+}
+
+// one draw of glMultiDrawElementsIndirect, laid out as GL reads it
+struct draw_elements_command
+{
+	GLuint count;
+	GLuint instance_count;
+	GLuint first_index;
+	GLint base_vertex;
+	GLuint base_instance;
 };
 
-class material
+// several draws from the same buffers and arrays, made with one call
+struct draw_batch
 {
-public:
-	~material()
+	std::vector<GLsizei> counts;
+	std::vector<const void*> offsets;
+	std::vector<GLint> base_vertices;
+
+	void clear()
 	{
-		if (tex != nullptr)
-		{
-			delete tex;
-		}
+		counts.clear();
+		offsets.clear();
+		base_vertices.clear();
 	}
 
-	void set()
+	size_t size() const
 	{
-		glMaterialfv(GL_FRONT, GL_DIFFUSE, diffuse);
-		glMaterialfv(GL_FRONT, GL_EMISSION, emissive);
-		glMaterialfv(GL_FRONT, GL_AMBIENT, ambient);
-		glMaterialfv(GL_FRONT, GL_SPECULAR, specular);
-		glMaterialf(GL_FRONT, GL_SHININESS, shininess);
-		tex->set();
+		return counts.size();
 	}
-
-	float diffuse[4];
-	float emissive[4];
-	float ambient[4];
-	float specular[4];
-	float shininess;
-	texture* tex = nullptr;
 };
 
-class model_node
+// the GL calls the render path makes. remembers the state they set and
+// leaves out calls that would not change it, counting both, so the cost of
+// different ways of submitting a frame can be compared.
+class gl_commands
 {
 public:
-	model_node()
+	gl_commands()
 	{
-
+		invalidate();
 	}
 
-	model_node(const model_node& ) = delete;
-	model_node& operator=(const model_node& ) = delete;
-	model_node(model_node&& ) = delete;
-	model_node& operator=(model_node&& ) = delete;
-
-	~model_node()
+	// forgets the remembered state, for when GL was used behind the back
+	// of this class, e.g. by uploads. the next call of each kind is made.
+	void invalidate()
 	{
-		model_node* child = first_child;
-
-		while(child)
+		array_buffer = unknown_name;
+		indirect_buffer = unknown_name;
+		texture = unknown_name;
+		vertex_array = unknown_name;
+		arrays = vertex_array_state();
+		default_arrays = vertex_array_state();
+
+		for (int i = 0; i < 4; ++i)
 		{
-			model_node* tmp = child->next_sibling;
-			delete child;
-			child = tmp;
+			material_values[i].fill(std::nanf(""));
 		}
 
-		if (m != nullptr)
-		{
-			delete m;
-		}
+		shininess = std::nanf("");
+		current_matrix_mode = 0;
+	}
 
-		if (mat != nullptr)
+	// GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER or GL_DRAW_INDIRECT_BUFFER
+	void bind_buffer(GLenum target, GLuint buffer)
+	{
+		if (update(target == GL_ARRAY_BUFFER ? array_buffer : (target == GL_ELEMENT_ARRAY_BUFFER ? arrays.element_buffer : indirect_buffer), buffer))
 		{
-			delete mat;
+			glBindBuffer(target, buffer);
 		}
 	}
 
-	void render()
+	// replaces the data of the buffer bound to target, always made
+	void buffer_data(GLenum target, size_t size, const void* data)
 	{
-		model_node* child = first_child;
+		++issued;
+		glBufferData(target, size, data, GL_STREAM_DRAW);
+	}
 
-		while(child)
+	void bind_texture(GLuint tex)
+	{
+		if (update(texture, tex))
 		{
-			child->render();
-			child = child->next_sibling;
+			glBindTexture(GL_TEXTURE_2D, tex);
 		}
+	}
 
-		if (m)
+	void enable_client_state(GLenum array)
+	{
+		if (update(arrays.client_states[client_state_index(array)], 1))
 		{
-			mat->set();
-			m->render();
+			glEnableClientState(array);
 		}
 	}
 
-	model_node* find(const std::string& name)
+	void disable_client_state(GLenum array)
 	{
-		if (name == this->name)
+		if (update(arrays.client_states[client_state_index(array)], 0))
 		{
-			return this;
+			glDisableClientState(array);
 		}
+	}
 
-		for (model_node* child = first_child; child != nullptr; child = child->next_sibling)
+	void vertex_pointer(GLenum type, int stride, int offset)
+	{
+		if (update(arrays.vertex, array_pointer{array_buffer, type, stride, offset}))
 		{
-			model_node* ret = child->find(name);
-
-			if (ret != nullptr)
-			{
-				return ret;
-			}
+			glVertexPointer(3, type, stride, buffer_offset(offset));
 		}
+	}
 
-		return nullptr;
+	void tex_coord_pointer(GLenum type, int stride, int offset)
+	{
+		if (update(arrays.tex_coord, array_pointer{array_buffer, type, stride, offset}))
+		{
+			glTexCoordPointer(2, type, stride, buffer_offset(offset));
+		}
 	}
 
-	void set_transform_data(const vector3& pos, const quaternion& rot, const vector3& scale)
+	void normal_pointer(GLenum type, int stride, int offset)
 	{
-		this->pos = pos;
-		this->rot = rot;
-		this->scale = scale;
+		if (update(arrays.normal, array_pointer{array_buffer, type, stride, offset}))
+		{
+			glNormalPointer(type, stride, buffer_offset(offset));
+		}
 	}
 
-	void update_transform(const matrix4& parent_mat)
+	// the element buffer, client states and pointers belong to the bound
+	// object. those of the default object 0 are remembered while another
+	// one is bound, the others are set up once and then only bound.
+	void bind_vertex_array(GLuint name)
 	{
-		transform = parent_mat * original_transform * translation(pos) * rotation(rot) * non_uniform_scale(scale);
+		GLuint previous = vertex_array;
 
-		for (model_node* child = first_child; child != nullptr; child = child->next_sibling)
+		if (!update(vertex_array, name))
 		{
-			child->update_transform(transform);
+			return;
+		}
+
+		glBindVertexArray(name);
+
+		if (previous == 0)
+		{
+			default_arrays = arrays;
 		}
+
+		arrays = name == 0 && previous != unknown_name ? default_arrays : vertex_array_state();
 	}
 
-	matrix4 get_transform() const
+	// GL_DIFFUSE, GL_EMISSION, GL_AMBIENT or GL_SPECULAR of the front face
+	void material(GLenum name, const float* value)
 	{
-		return transform;
+		std::array<float, 4> v = {{value[0], value[1], value[2], value[3]}};
+
+		if (update(material_values[material_index(name)], v))
+		{
+			glMaterialfv(GL_FRONT, name, value);
+		}
 	}
 
-	void update_meshes(model_node* root, const matrix4& global_inverse)
+	// GL_SHININESS of the front face
+	void material(GLenum name, float value)
 	{
-		for (model_node* child = first_child; child != nullptr; child = child->next_sibling)
+		if (update(shininess, value))
 		{
-			child->update_meshes(root, global_inverse);
+			glMaterialf(GL_FRONT, name, value);
 		}
+	}
 
-		if (m != nullptr)
+	void matrix_mode(GLenum mode)
+	{
+		if (update(current_matrix_mode, mode))
 		{
-			m->update(root, global_inverse);
+			glMatrixMode(mode);
 		}
 	}
 
-	friend void load_mesh_from_assimp_node(model_node** mesh_node, const aiNode* assimp_node, const aiScene* scene);
-	friend model_node* traverse_assimp_scene(const aiNode* curr, const aiScene* scene);
+	// the matrix stack is not remembered, these are always made
+	void push_matrix()
+	{
+		++issued;
+		glPushMatrix();
+	}
 
-private:
-	model_node* next_sibling = nullptr;
+	void pop_matrix()
+	{
+		++issued;
+		glPopMatrix();
+	}
+
+	void translate(float x, float y, float z)
+	{
+		++issued;
+		glTranslatef(x, y, z);
+	}
+
+	void scale(float x, float y, float z)
+	{
+		++issued;
+		glScalef(x, y, z);
+	}
+
+	// indices are relative to base_vertex, see base_vertex_available()
+	void draw_elements(int count, GLenum type, int offset, int base_vertex = 0)
+	{
+		++issued;
+		++draw_calls;
+
+		if (base_vertex != 0)
+		{
+			glDrawElementsBaseVertex(GL_TRIANGLES, count, type, buffer_offset(offset), base_vertex);
+		}
+		else
+		{
+			glDrawElements(GL_TRIANGLES, count, type, buffer_offset(offset));
+		}
+	}
+
+	void multi_draw_elements(GLenum type, const draw_batch& batch)
+	{
+		++issued;
+		++draw_calls;
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, batch.counts.data(), type, batch.offsets.data(),
+									  static_cast<GLsizei>(batch.size()), batch.base_vertices.data());
+	}
+
+	// draw_count commands from the bound GL_DRAW_INDIRECT_BUFFER, starting
+	// offset bytes into it
+	void multi_draw_elements_indirect(GLenum type, int offset, int draw_count)
+	{
+		++issued;
+		++draw_calls;
+		glMultiDrawElementsIndirect(GL_TRIANGLES, type, buffer_offset(offset), draw_count, 0);
+	}
+
+	int issued = 0;
+	int filtered = 0;
+	// the issued calls that draw
+	int draw_calls = 0;
+	// off makes every call, for comparison
+	bool filtering = true;
+	// meshes are drawn from their vertex array objects, only set if
+	// vertex_arrays_available()
+	bool vertex_arrays = false;
+
+private:
+	static const GLuint unknown_name = ~0u;
+
+	// the buffer is part of the pointer, it is latched when the pointer is set
+	struct array_pointer
+	{
+		GLuint buffer = unknown_name;
+		GLenum type = 0;
+		int stride = 0;
+		int offset = 0;
+
+		bool operator==(const array_pointer& other) const
+		{
+			return buffer != unknown_name && buffer == other.buffer && type == other.type &&
+				   stride == other.stride && offset == other.offset;
+		}
+	};
+
+	struct vertex_array_state
+	{
+		GLuint element_buffer = unknown_name;
+		// vertex, texture coordinate and normal array, -1 if unknown
+		int client_states[3] = {-1, -1, -1};
+		array_pointer vertex;
+		array_pointer tex_coord;
+		array_pointer normal;
+	};
+
+	// counts the call and returns whether it has to be made. unknown
+	// values never compare equal, floats are NaN then.
+	template <typename T>
+	bool update(T& current, const T& value)
+	{
+		if (filtering && current == value)
+		{
+			++filtered;
+			return false;
+		}
+
+		current = value;
+		++issued;
+		return true;
+	}
+
+	static int client_state_index(GLenum array)
+	{
+		return array == GL_VERTEX_ARRAY ? 0 : (array == GL_TEXTURE_COORD_ARRAY ? 1 : 2);
+	}
+
+	static int material_index(GLenum name)
+	{
+		return name == GL_DIFFUSE ? 0 : (name == GL_EMISSION ? 1 : (name == GL_AMBIENT ? 2 : 3));
+	}
+
+	GLuint array_buffer;
+	GLuint indirect_buffer;
+	GLuint texture;
+	GLuint vertex_array;
+	vertex_array_state arrays;
+	vertex_array_state default_arrays;
+	std::array<float, 4> material_values[4];
+	float shininess;
+	GLenum current_matrix_mode = 0;
+};
+
+// what a mesh needs to know about the view to decide whether and at which
+// level of detail it is drawn, plus counters of what that came down to
+struct render_view
+{
+	// the meshes are drawn with this modelview matrix
+	matrix4 modelview;
+	frustum view_frustum;
+	bool culling = true;
+	// size in pixels of one unit at distance 1, see resize()
+	float pixels_per_unit = 1.0f;
+	// coarser levels are used as long as they are off by fewer pixels
+	float max_error_pixels = 1.0f;
+	int triangles[max_lod_count] = {};
+	int draws[max_lod_count] = {};
+	int culled = 0;
+	int occluded = 0;
+	gl_commands gl;
+
+	void reset_stats()
+	{
+		std::fill(triangles, triangles + max_lod_count, 0);
+		std::fill(draws, draws + max_lod_count, 0);
+		culled = 0;
+		occluded = 0;
+		gl.issued = 0;
+		gl.filtered = 0;
+		gl.draw_calls = 0;
+	}
+
+	bool visible(const vector3& center, float radius) const
+	{
+		return !culling || sphere_in_frustum(view_frustum, center, radius);
+	}
+
+	// index into lods for a mesh with the given bounding sphere
+	int select_lod(const std::vector<mesh_lod>& lods, const vector3& center, float radius) const
+	{
+		float distance = vector_length(transform_vector(modelview, center)) - radius;
+		int ret = 0;
+
+		if (distance <= 0.0f)
+		{
+			return ret;
+		}
+
+		while (ret + 1 < static_cast<int>(lods.size()) && lods[ret + 1].error * pixels_per_unit / distance <= max_error_pixels)
+		{
+			++ret;
+		}
+
+		return ret;
+	}
+};
+
+// binds the buffers and sets up the arrays of layout, which is what a vertex
+// array object holds. the arrays the layout does not have are disabled.
+void set_vertex_arrays(gl_commands& gl, const vertex_layout& layout, GLuint vertex_buffer, GLuint index_buffer)
+{
+	const vertex_layout& l = layout;
+
+	gl.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+	gl.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+
+	gl.enable_client_state(GL_VERTEX_ARRAY);
+	gl.vertex_pointer(l.position_format == format_quantized ? GL_SHORT : GL_FLOAT, l.size, l.position_offset);
+
+	if (l.uv_offset >= 0)
+	{
+		gl.enable_client_state(GL_TEXTURE_COORD_ARRAY);
+		gl.tex_coord_pointer(l.uv_format == format_quantized ? GL_SHORT : GL_FLOAT, l.size, l.uv_offset);
+	}
+	else
+	{
+		gl.disable_client_state(GL_TEXTURE_COORD_ARRAY);
+	}
+
+	if (l.normal_offset >= 0)
+	{
+		gl.enable_client_state(GL_NORMAL_ARRAY);
+		gl.normal_pointer(l.normal_format == format_snorm8 ? GL_BYTE : GL_FLOAT, l.size, l.normal_offset);
+	}
+	else
+	{
+		gl.disable_client_state(GL_NORMAL_ARRAY);
+	}
+}
+
+// a vertex and an index buffer that many meshes of the same vertex format
+// and index size are suballocated from, so they are drawn one after the
+// other without binding anything and can be merged into one multi-draw.
+// the ranges are handed out before create_buffers(), the meshes fill them.
+class shared_geometry
+{
+public:
+	shared_geometry(const vertex_layout& layout, int index_size)
+		: layout(gpu_vertex_layout(layout)), index_size(index_size)
+	{
+
+	}
+
+	shared_geometry(const shared_geometry& ) = delete;
+	shared_geometry& operator=(const shared_geometry& ) = delete;
+	shared_geometry(shared_geometry&& ) = delete;
+	shared_geometry& operator=(shared_geometry&& ) = delete;
+
+	~shared_geometry()
+	{
+		GLuint bufferNames[2] = {vertexBuffer, indexBuffer};
+		glDeleteBuffers(2, bufferNames);
+
+		if (vertexArray != 0)
+		{
+			glDeleteVertexArrays(1, &vertexArray);
+		}
+	}
+
+	bool fits(const vertex_layout& other, int other_index_size) const
+	{
+		return other_index_size == index_size && same_vertex_format(gpu_vertex_layout(other), layout);
+	}
+
+	// reserves the room for a mesh, base_vertex is its first vertex and
+	// index_offset where its indices start in bytes
+	void allocate(int vertices, int indices, int& base_vertex, int& index_offset)
+	{
+		base_vertex = vertex_count;
+		index_offset = index_count * index_size;
+		vertex_count += vertices;
+		index_count += indices;
+	}
+
+	// must be called on the GL thread before the meshes create their
+	// buffers
+	void create_buffers()
+	{
+		GLuint bufferNames[2];
+		glGenBuffers(2, bufferNames);
+		vertexBuffer = *bufferNames;
+		indexBuffer = *(bufferNames + 1);
+
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, vertex_count * layout.size, nullptr, GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_count * index_size, nullptr, GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+		if (vertex_arrays_available())
+		{
+			glGenVertexArrays(1, &vertexArray);
+			glBindVertexArray(vertexArray);
+			gl_commands setup;
+			set_vertex_arrays(setup, layout, vertexBuffer, indexBuffer);
+			glBindVertexArray(0);
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	GLuint vertex_buffer_name() const
+	{
+		return vertexBuffer;
+	}
+
+	GLuint index_buffer_name() const
+	{
+		return indexBuffer;
+	}
+
+	GLuint vertex_array_name() const
+	{
+		return vertexArray;
+	}
+
+private:
+	vertex_layout layout;
+	int index_size;
+	int vertex_count = 0;
+	int index_count = 0;
+	GLuint vertexBuffer = 0;
+	GLuint indexBuffer = 0;
+	GLuint vertexArray = 0;
+};
+
+class mesh
+{
+public:
+	mesh(uint8_t* vertex_data, int vertex_cnt, const vertex_layout& layout,
+		 uint8_t* index_data, int indexCnt, int indexSize, std::vector<mesh_lod> lods,
+		 std::vector<bone> bones)
+		: vertex_data(vertex_data), vertex_cnt(vertex_cnt), layout(layout), gpu_layout(gpu_vertex_layout(layout)),
+		  index_data(index_data), indexCnt(indexCnt), indexSize(indexSize), lods(std::move(lods)), bones(std::move(bones))
+	{
+		gather_bind_pose(this->bones, vertex_data, layout);
+
+		// bind pose bounds, used until the first update() poses the mesh
+		vector3 min(HUGE_VALF, HUGE_VALF, HUGE_VALF);
+		vector3 max(-HUGE_VALF, -HUGE_VALF, -HUGE_VALF);
+
+		for (int i = 0; i < vertex_cnt; ++i)
+		{
+			vector3 p = read_position(vertex_data + i * layout.size, layout);
+			min = vector3(std::min(min.x, p.x), std::min(min.y, p.y), std::min(min.z, p.z));
+			max = vector3(std::max(max.x, p.x), std::max(max.y, p.y), std::max(max.z, p.z));
+		}
+
+		if (vertex_cnt > 0)
+		{
+			bounds_center = (min + max) * 0.5f;
+			bounds_radius = vector_length(max - min) * 0.5f;
+		}
+
+		skinned_positions.resize(vertex_cnt);
+
+		if (layout.normal_offset >= 0)
+		{
+			skinned_normals.resize(vertex_cnt);
+		}
+
+		size_t max_influences = 0;
+
+		for (std::vector<bone>::iterator iter = this->bones.begin(); iter != this->bones.end(); ++iter)
+		{
+			max_influences = std::max(max_influences, iter->vertices.size());
+
+			vector3 bone_min(HUGE_VALF, HUGE_VALF, HUGE_VALF);
+			vector3 bone_max(-HUGE_VALF, -HUGE_VALF, -HUGE_VALF);
+
+			for (size_t i = 0; i < iter->bind_x.size(); ++i)
+			{
+				bone_min = vector3(std::min(bone_min.x, iter->bind_x[i]), std::min(bone_min.y, iter->bind_y[i]), std::min(bone_min.z, iter->bind_z[i]));
+				bone_max = vector3(std::max(bone_max.x, iter->bind_x[i]), std::max(bone_max.y, iter->bind_y[i]), std::max(bone_max.z, iter->bind_z[i]));
+			}
+
+			if (!iter->bind_x.empty())
+			{
+				iter->bind_min = bone_min;
+				iter->bind_max = bone_max;
+			}
+		}
+
+		// weights are only normalized if the importer or the cooker was asked
+		// to, pose() widens the bounds for vertices where they are not
+		std::vector<float> weight_sums(vertex_cnt, 0.0f);
+
+		for (std::vector<bone>::const_iterator iter = this->bones.begin(); iter != this->bones.end(); ++iter)
+		{
+			for (std::vector<std::pair<int, float>>::const_iterator influence = iter->vertices.begin(); influence != iter->vertices.end(); ++influence)
+			{
+				weight_sums[influence->first] += influence->second;
+			}
+		}
+
+		if (vertex_cnt > 0)
+		{
+			min_weight_sum = *std::min_element(weight_sums.begin(), weight_sums.end());
+			max_weight_sum = *std::max_element(weight_sums.begin(), weight_sums.end());
+		}
+
+		palette.resize(this->bones.size());
+
+		skinned_x.resize(max_influences);
+		skinned_y.resize(max_influences);
+		skinned_z.resize(max_influences);
+	}
+
+	mesh(const mesh& ) = delete;
+	mesh& operator=(const mesh& ) = delete;
+	mesh(mesh&& ) = delete;
+	mesh& operator=(mesh&& ) = delete;
+
+	~mesh()
+	{
+		// shared buffers belong to the shared_geometry
+		if (shared != nullptr)
+		{
+			return;
+		}
+
+		GLuint bufferNames[2] = {vertexBuffer, indexBuffer};
+		glDeleteBuffers(2, bufferNames);
+
+		if (vertexArray != 0)
+		{
+			glDeleteVertexArrays(1, &vertexArray);
+		}
+	}
+
+	// draws the mesh from a range of g instead of buffers of its own. must
+	// be called before create_buffers(), on any thread.
+	void share(shared_geometry& g)
+	{
+		shared = &g;
+		g.allocate(vertex_cnt, indexCnt, base_vertex, index_offset);
+	}
+
+	const vertex_layout& vertex_format() const
+	{
+		return layout;
+	}
+
+	int index_size() const
+	{
+		return indexSize;
+	}
+
+	// the constructor does not touch GL, this creates the buffers and the
+	// vertex array object and must be called on the GL thread before the
+	// mesh is rendered. shared meshes fill their range of the buffers of the
+	// shared_geometry instead, which must have created them.
+	void create_buffers()
+	{
+		if (shared != nullptr)
+		{
+			vertexBuffer = shared->vertex_buffer_name();
+			indexBuffer = shared->index_buffer_name();
+			vertexArray = shared->vertex_array_name();
+		}
+		else
+		{
+			GLuint bufferNames[2];
+			glGenBuffers(2, bufferNames);
+			vertexBuffer = *bufferNames;
+			indexBuffer = *(bufferNames + 1);
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+
+		if (gpu_layout.normal_format != layout.normal_format)
+		{
+			std::vector<uint8_t> converted(vertex_data, vertex_data + vertex_cnt * layout.size);
+
+			for (int i = 0; i < vertex_cnt; ++i)
+			{
+				write_normal(converted.data() + i * layout.size, gpu_layout, read_normal(vertex_data + i * layout.size, layout));
+			}
+
+			write_buffer(GL_ARRAY_BUFFER, base_vertex * layout.size, converted.size(), converted.data());
+		}
+		else
+		{
+			write_buffer(GL_ARRAY_BUFFER, base_vertex * layout.size, vertex_cnt * layout.size, vertex_data);
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		write_buffer(GL_ELEMENT_ARRAY_BUFFER, index_offset, indexCnt * indexSize, index_data);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+		if (shared == nullptr && vertex_arrays_available())
+		{
+			// upload() keeps the formats and offsets, so this stays valid
+			glGenVertexArrays(1, &vertexArray);
+			glBindVertexArray(vertexArray);
+			gl_commands setup;
+			set_vertex_arrays(setup, gpu_layout, vertexBuffer, indexBuffer);
+			glBindVertexArray(0);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+	}
+
+	// the level of detail to draw, or -1 for culled meshes. the bounds are
+	// those of the last pose(), so a mesh that skin() skipped is not drawn
+	// with a stale pose as long as the view did not change in between.
+	int select(render_view& view) const
+	{
+		if (!view.visible(bounds_center, bounds_radius))
+		{
+			++view.culled;
+			return -1;
+		}
+
+		if (occluded)
+		{
+			++view.occluded;
+			return -1;
+		}
+
+		int level = view.select_lod(lods, bounds_center, bounds_radius);
+		view.triangles[level] += lods[level].index_count / 3;
+		++view.draws[level];
+		return level;
+	}
+
+	// distance of the bounds from the eye, for sorting
+	float view_depth(const render_view& view) const
+	{
+		return std::max(0.0f, vector_length(transform_vector(view.modelview, bounds_center)) - bounds_radius);
+	}
+
+	GLuint vertex_buffer_name() const
+	{
+		return vertexBuffer;
+	}
+
+	// binds the vertex array object, or without one the buffers and arrays,
+	// for draw(). quantized attributes are decoded by the modelview and
+	// texture matrices, which unbind() restores.
+	void bind(gl_commands& gl) const
+	{
+		if (gl.vertex_arrays)
+		{
+			gl.bind_vertex_array(vertexArray);
+		}
+
+		if (!gl.vertex_arrays || vertexArray == 0)
+		{
+			set_vertex_arrays(gl, gpu_layout, vertexBuffer, indexBuffer);
+		}
+
+		const vertex_layout& l = gpu_layout;
+
+		if (l.position_format == format_quantized)
+		{
+			gl.push_matrix();
+			gl.translate(l.position_bias[0], l.position_bias[1], l.position_bias[2]);
+			gl.scale(l.position_scale, l.position_scale, l.position_scale);
+		}
+
+		if (l.uv_offset >= 0 && l.uv_format == format_quantized)
+		{
+			gl.matrix_mode(GL_TEXTURE);
+			gl.push_matrix();
+			gl.translate(l.uv_bias[0], l.uv_bias[1], 0.0f);
+			gl.scale(l.uv_scale[0], l.uv_scale[1], 1.0f);
+			gl.matrix_mode(GL_MODELVIEW);
+		}
+	}
+
+	void draw(gl_commands& gl, int level) const
+	{
+		gl.draw_elements(lods[level].index_count, gl_index_type(indexSize), index_offset + lods[level].first_index * indexSize, base_vertex);
+	}
+
+	// whether draws of meshes sharing the same buffers can be merged into
+	// one batch, which needs bind() to leave the matrices alone
+	bool batchable() const
+	{
+		return shared != nullptr && gpu_layout.position_format != format_quantized &&
+			   (gpu_layout.uv_offset < 0 || gpu_layout.uv_format != format_quantized);
+	}
+
+	const shared_geometry* shared_buffers() const
+	{
+		return shared;
+	}
+
+	void add_draw(draw_batch& batch, int level) const
+	{
+		batch.counts.push_back(lods[level].index_count);
+		batch.offsets.push_back(buffer_offset(index_offset + lods[level].first_index * indexSize));
+		batch.base_vertices.push_back(base_vertex);
+	}
+
+	void add_draw(std::vector<draw_elements_command>& commands, int level) const
+	{
+		GLuint first_index = static_cast<GLuint>(index_offset / indexSize) + lods[level].first_index;
+		commands.push_back(draw_elements_command{lods[level].index_count, 1, first_index, base_vertex, 0});
+	}
+
+	// undoes the matrices of bind(), the arrays and buffers stay
+	void unbind(gl_commands& gl) const
+	{
+		if (gpu_layout.uv_offset >= 0 && gpu_layout.uv_format == format_quantized)
+		{
+			gl.matrix_mode(GL_TEXTURE);
+			gl.pop_matrix();
+			gl.matrix_mode(GL_MODELVIEW);
+		}
+
+		if (gpu_layout.position_format == format_quantized)
+		{
+			gl.pop_matrix();
+		}
+	}
+
+	// leaves no arrays enabled and no buffers bound, after the last mesh
+	static void reset(gl_commands& gl)
+	{
+		if (gl.vertex_arrays)
+		{
+			gl.bind_vertex_array(0);
+		}
+
+		gl.disable_client_state(GL_NORMAL_ARRAY);
+		gl.disable_client_state(GL_TEXTURE_COORD_ARRAY);
+		gl.disable_client_state(GL_VERTEX_ARRAY);
+		gl.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		gl.bind_buffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// draws the mesh right away and leaves no state behind
+	void render(render_view& view) const
+	{
+		int level = select(view);
+
+		if (level < 0)
+		{
+			return;
+		}
+
+		bind(view.gl);
+		draw(view.gl, level);
+		unbind(view.gl);
+		reset(view.gl);
+	}
+
+	// moves the bounds to the current pose of the bones, which is cheap
+	// compared to skin()
+	void pose(model_node* root, const matrix4& global_inverse);
+
+	// skins the vertices on the CPU for the last pose(), unless the posed
+	// bounds are outside of view or hidden behind the occluders. does not
+	// touch GL so it can run on any thread.
+	void skin(const frustum* view = nullptr, const occlusion_buffer* occlusion = nullptr);
+
+	// draws the coarsest level of detail of the last skin() into occlusion
+	void rasterize_occluder(occlusion_buffer& occlusion) const
+	{
+		// not skinned this frame, the pose would be stale
+		if (!skinned)
+		{
+			return;
+		}
+
+		const mesh_lod& coarsest = lods.back();
+
+		for (uint32_t i = coarsest.first_index; i + 2 < coarsest.first_index + coarsest.index_count; i += 3)
+		{
+			occlusion.rasterize_triangle(skinned_positions[read_index(index_data, indexSize, i)],
+										 skinned_positions[read_index(index_data, indexSize, i + 1)],
+										 skinned_positions[read_index(index_data, indexSize, i + 2)]);
+		}
+	}
+
+	// uploads the result of the last update, must be called on the GL thread
+	void upload();
+
+	// box around the bounding sphere of the last pose
+	bounding_box bounds() const
+	{
+		bounding_box ret;
+		ret.add(bounds_center - vector3(bounds_radius, bounds_radius, bounds_radius));
+		ret.add(bounds_center + vector3(bounds_radius, bounds_radius, bounds_radius));
+		return ret;
+	}
+
+	// size of the vertex and index buffers
+	size_t gpu_bytes() const
+	{
+		return vertex_cnt * layout.size + indexCnt * indexSize;
+	}
+
+	// memory owned by the mesh: bones, skinning output and scratch space.
+	// the source vertex and index data belong to whoever created the mesh.
+	size_t cpu_bytes() const
+	{
+		size_t ret = sizeof(mesh) + vertex_cnt * layout.size + skinned_x.size() * 3 * sizeof(float) +
+					 (skinned_positions.size() + skinned_normals.size()) * sizeof(vector3) + palette.size() * sizeof(matrix4);
+
+		for (std::vector<bone>::const_iterator iter = bones.begin(); iter != bones.end(); ++iter)
+		{
+			ret += sizeof(bone) + iter->vertices.size() * (sizeof(std::pair<int, float>) + 4 * sizeof(float));
+		}
+
+		return ret;
+	}
+
+private:
+	// all of a buffer of its own or a range of a shared one
+	void write_buffer(GLenum target, int offset, size_t size, const void* data) const
+	{
+		if (shared != nullptr)
+		{
+			glBufferSubData(target, offset, size, data);
+		}
+		else
+		{
+			glBufferData(target, size, data, GL_STATIC_DRAW);
+		}
+	}
+
+	uint8_t* vertex_data;
+	int vertex_cnt;
+	vertex_layout layout;
+	// layout of what is in vertexBuffer right now
+	vertex_layout gpu_layout;
+	// layout of skinned_vertex_data, becomes gpu_layout on upload()
+	vertex_layout skinned_layout;
+	uint8_t* index_data;
+	GLuint vertexBuffer = 0;
+	GLuint indexBuffer = 0;
+	// 0 if vertex array objects are not available
+	GLuint vertexArray = 0;
+	// where the buffer names come from if not from create_buffers(), the
+	// vertices and indices start at base_vertex and index_offset then
+	shared_geometry* shared = nullptr;
+	int base_vertex = 0;
+	int index_offset = 0;
+	int indexCnt;
+	int indexSize;
+	// ranges of the index buffer, the full mesh first
+	std::vector<mesh_lod> lods;
+	// bounding sphere of the last pose
+	vector3 bounds_center;
+	float bounds_radius = 0.0f;
+	// range of the sums of the bone weights of a vertex
+	float min_weight_sum = 1.0f;
+	float max_weight_sum = 1.0f;
+	std::vector<bone> bones;
+	// bone transforms of the last pose
+	std::vector<matrix4> palette;
+
+	std::vector<uint8_t> skinned_vertex_data;
+	// skinned_vertex_data holds a pose that was not uploaded yet
+	bool skinned = false;
+	// skin() found the bounds hidden behind the occluders
+	bool occluded = false;
+
+	// skinning result as floats, before it is converted to skinned_layout
+	std::vector<vector3> skinned_positions;
+	std::vector<vector3> skinned_normals;
+
+	// scratch space for the output of one bone in update()
+	std::vector<float> skinned_x;
+	std::vector<float> skinned_y;
+	std::vector<float> skinned_z;
+};
+
+// the shared_geometry for meshes of any format, one per vertex format and
+// index size. the meshes of a model or of several models are added before
+// their buffers are created, see model::share_buffers().
+class geometry_pool
+{
+public:
+	geometry_pool()
+	{
+
+	}
+
+	geometry_pool(const geometry_pool& ) = delete;
+	geometry_pool& operator=(const geometry_pool& ) = delete;
+	geometry_pool(geometry_pool&& ) = delete;
+	geometry_pool& operator=(geometry_pool&& ) = delete;
+
+	~geometry_pool()
+	{
+		for (std::vector<shared_geometry*>::iterator iter = groups.begin(); iter != groups.end(); ++iter)
+		{
+			delete *iter;
+		}
+	}
+
+	void add(mesh* m)
+	{
+		std::vector<shared_geometry*>::iterator found = std::find_if(groups.begin(), groups.end(),
+			[&](const shared_geometry* g) { return g->fits(m->vertex_format(), m->index_size()); });
+
+		if (found == groups.end())
+		{
+			groups.push_back(new shared_geometry(m->vertex_format(), m->index_size()));
+			found = groups.end() - 1;
+		}
+
+		m->share(**found);
+	}
+
+	// must be called on the GL thread before the meshes create their
+	// buffers
+	void create_buffers()
+	{
+		for (std::vector<shared_geometry*>::iterator iter = groups.begin(); iter != groups.end(); ++iter)
+		{
+			(*iter)->create_buffers();
+		}
+	}
+
+	size_t size() const
+	{
+		return groups.size();
+	}
+
+private:
+	std::vector<shared_geometry*> groups;
+};
+
+class texture
+{
+public:
+	texture()
+	{
+
+	}
+
+	texture(const texture& ) = delete;
+	texture& operator=(const texture& ) = delete;
+	texture(texture&& ) = delete;
+	texture& operator=(texture&& ) = delete;
+
+	~texture()
+	{
+		glDeleteTextures(1, &tex);
+	}
+
+	// creates the GL texture, must be called on the GL thread
+	void upload(const void* pixels, int width, int height)
+	{
+		glGenTextures(1, &tex);
+		glBindTexture(GL_TEXTURE_2D, tex);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	GLuint name() const
+	{
+		return tex;
+	}
+
+private:
+	GLuint tex = 0;
+};
+
+class material
+{
+public:
+	void set(gl_commands& gl) const
+	{
+		gl.material(GL_DIFFUSE, diffuse);
+		gl.material(GL_EMISSION, emissive);
+		gl.material(GL_AMBIENT, ambient);
+		gl.material(GL_SPECULAR, specular);
+		gl.material(GL_SHININESS, shininess);
+		// untextured materials must not draw with the texture of the last one
+		gl.bind_texture(tex != nullptr ? tex->name() : 0);
+	}
+
+	float diffuse[4];
+	float emissive[4];
+	float ambient[4];
+	float specular[4];
+	float shininess;
+	texture* tex = nullptr;
+};
+
+// collects the meshes of a frame and draws them sorted by state, so meshes
+// sharing a texture, material or buffer are drawn one after the other and
+// only the state that differs from the previous draw is set
+class render_queue
+{
+public:
+	render_queue()
+	{
+
+	}
+
+	render_queue(const render_queue& ) = delete;
+	render_queue& operator=(const render_queue& ) = delete;
+	render_queue(render_queue&& ) = delete;
+	render_queue& operator=(render_queue&& ) = delete;
+
+	~render_queue()
+	{
+		if (indirect_buffer != 0)
+		{
+			glDeleteBuffers(1, &indirect_buffer);
+		}
+	}
+
+	void clear()
+	{
+		items.clear();
+		materials.clear();
+	}
+
+	void add(const render_view& view, const material* mat, const mesh* m, int level)
+	{
+		// the material part is the order the materials were first seen in
+		// this frame, there are few of them
+		std::vector<const material*>::iterator found = std::find(materials.begin(), materials.end(), mat);
+		uint64_t material_id = found - materials.begin();
+
+		if (found == materials.end())
+		{
+			materials.push_back(mat);
+		}
+
+		// positive floats order like their bits, the top 16 keep the
+		// exponent and some of the mantissa
+		float depth = m->view_depth(view);
+		uint32_t depth_bits;
+		std::memcpy(&depth_bits, &depth, sizeof(depth_bits));
+
+		// names are cut to 16 bits, two that end up equal only cost the
+		// state changes between them
+		uint64_t texture_name = mat->tex != nullptr ? mat->tex->name() : 0;
+		uint64_t key = (texture_name & 0xffff) << 48 | (material_id & 0xffff) << 32 |
+					   (m->vertex_buffer_name() & 0xffff) << 16 | depth_bits >> 16;
+
+		items.push_back(draw_item{key, mat, m, level});
+	}
+
+	// front to back within a state, which helps early depth rejection
+	void submit(gl_commands& gl)
+	{
+		std::sort(items.begin(), items.end(), [](const draw_item& a, const draw_item& b) { return a.key < b.key; });
+
+		// the commands of all batches go into the buffer at once, before
+		// the first of them is drawn
+		if (indirect)
+		{
+			commands.clear();
+
+			for (std::vector<draw_item>::const_iterator iter = items.begin(); iter != items.end(); ++iter)
+			{
+				std::vector<draw_item>::const_iterator last = batch_end(iter);
+
+				if (last != iter)
+				{
+					for (std::vector<draw_item>::const_iterator item = iter; item != last + 1; ++item)
+					{
+						item->m->add_draw(commands, item->level);
+					}
+				}
+
+				iter = last;
+			}
+
+			if (indirect_buffer == 0)
+			{
+				glGenBuffers(1, &indirect_buffer);
+			}
+
+			gl.bind_buffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer);
+			gl.buffer_data(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(draw_elements_command), commands.data());
+		}
+
+		const material* bound_material = nullptr;
+		const mesh* bound_mesh = nullptr;
+		int command_count = 0;
+
+		for (std::vector<draw_item>::const_iterator iter = items.begin(); iter != items.end(); ++iter)
+		{
+			if (iter->mat != bound_material)
+			{
+				iter->mat->set(gl);
+				bound_material = iter->mat;
+			}
+
+			if (iter->m != bound_mesh)
+			{
+				if (bound_mesh != nullptr)
+				{
+					bound_mesh->unbind(gl);
+				}
+
+				iter->m->bind(gl);
+				bound_mesh = iter->m;
+			}
+
+			std::vector<draw_item>::const_iterator last = batch_end(iter);
+
+			if (last == iter)
+			{
+				iter->m->draw(gl, iter->level);
+				continue;
+			}
+
+			if (indirect)
+			{
+				int draw_count = static_cast<int>(last + 1 - iter);
+				gl.multi_draw_elements_indirect(gl_index_type(iter->m->index_size()), command_count * sizeof(draw_elements_command), draw_count);
+				command_count += draw_count;
+				iter = last;
+				continue;
+			}
+
+			batch.clear();
+
+			for (std::vector<draw_item>::const_iterator item = iter; item != last + 1; ++item)
+			{
+				item->m->add_draw(batch, item->level);
+			}
+
+			gl.multi_draw_elements(gl_index_type(iter->m->index_size()), batch);
+			iter = last;
+		}
+
+		if (bound_mesh != nullptr)
+		{
+			bound_mesh->unbind(gl);
+			mesh::reset(gl);
+		}
+
+		if (indirect)
+		{
+			gl.bind_buffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		}
+	}
+
+	size_t size() const
+	{
+		return items.size();
+	}
+
+	// off draws meshes from shared buffers one by one, for comparison
+	bool batching = true;
+	// batches are drawn with glMultiDrawElementsIndirect from a buffer
+	// written once per frame, only set if indirect_draw_available()
+	bool indirect = false;
+
+private:
+	struct draw_item
+	{
+		uint64_t key;
+		const material* mat;
+		const mesh* m;
+		int level;
+	};
+
+	// the last of the draws from iter on that are merged into one call.
+	// those with the same material from the same buffers are, they are next
+	// to each other in key order.
+	std::vector<draw_item>::const_iterator batch_end(std::vector<draw_item>::const_iterator iter) const
+	{
+		std::vector<draw_item>::const_iterator ret = iter;
+
+		if (batching && iter->m->batchable())
+		{
+			while (ret + 1 != items.end() && (ret + 1)->mat == iter->mat && (ret + 1)->m->batchable() &&
+				   (ret + 1)->m->shared_buffers() == iter->m->shared_buffers())
+			{
+				++ret;
+			}
+		}
+
+		return ret;
+	}
+
+	std::vector<draw_item> items;
+	std::vector<const material*> materials;
+	draw_batch batch;
+	std::vector<draw_elements_command> commands;
+	GLuint indirect_buffer = 0;
+};
+
+class model_node
+{
+public:
+	model_node()
+	{
+
+	}
+
+	model_node(const model_node& ) = delete;
+	model_node& operator=(const model_node& ) = delete;
+	model_node(model_node&& ) = delete;
+	model_node& operator=(model_node&& ) = delete;
+
+	void render(render_view& view)
+	{
+		model_node* child = first_child;
+
+		while(child)
+		{
+			child->render(view);
+			child = child->next_sibling;
+		}
+
+		if (m)
+		{
+			mat->set(view.gl);
+			m->render(view);
+		}
+	}
+
+	// adds the meshes below and including this node to queue instead of
+	// drawing them
+	void queue(render_view& view, render_queue& queue)
+	{
+		for (model_node* child = first_child; child != nullptr; child = child->next_sibling)
+		{
+			child->queue(view, queue);
+		}
+
+		if (m)
+		{
+			int level = m->select(view);
+
+			if (level >= 0)
+			{
+				queue.add(view, mat, m, level);
+			}
+		}
+	}
+
+	model_node* find(const std::string& name)
+	{
+		if (name == this->name)
+		{
+			return this;
+		}
+
+		for (model_node* child = first_child; child != nullptr; child = child->next_sibling)
+		{
+			model_node* ret = child->find(name);
+
+			if (ret != nullptr)
+			{
+				return ret;
+			}
+		}
+
+		return nullptr;
+	}
+
+	void set_transform_data(const vector3& pos, const quaternion& rot, const vector3& scale)
+	{
+		this->pos = pos;
+		this->rot = rot;
+		this->scale = scale;
+	}
+
+	void update_transform(const matrix4& parent_mat, worker_pool* pool = nullptr)
+	{
+		transform = parent_mat * original_transform * translation(pos) * rotation(rot) * non_uniform_scale(scale);
+
+		// sibling subtrees only read this node's transform, so large ones
+		// can be updated in parallel without affecting the result
+		if (pool != nullptr && subtree_size >= parallel_subtree_size && first_child != nullptr)
+		{
+			std::vector<model_node*> children;
+
+			for (model_node* child = first_child; child != nullptr; child = child->next_sibling)
+			{
+				children.push_back(child);
+			}
+
+			pool->parallel_for(static_cast<int>(children.size()), [&](int i)
+			{
+				children[i]->update_transform(transform, pool);
+			});
+
+			return;
+		}
+
+		for (model_node* child = first_child; child != nullptr; child = child->next_sibling)
+		{
+			child->update_transform(transform);
+		}
+	}
+
+	// counts the nodes below and including this one, the result is cached
+	// to decide whether update_transform should split up the work
+	int update_subtree_size()
+	{
+		subtree_size = 1;
+
+		for (model_node* child = first_child; child != nullptr; child = child->next_sibling)
+		{
+			subtree_size += child->update_subtree_size();
+		}
+
+		return subtree_size;
+	}
+
+	matrix4 get_transform() const
+	{
+		return transform;
+	}
+
+	// appends every mesh below and including this node, once per node that
+	// references it
+	void collect_meshes(std::vector<mesh*>& out)
+	{
+		for (model_node* child = first_child; child != nullptr; child = child->next_sibling)
+		{
+			child->collect_meshes(out);
+		}
+
+		if (m != nullptr)
+		{
+			out.push_back(m);
+		}
+	}
+
+	friend void load_mesh_from_assimp_node(model_node** mesh_node, const aiNode* assimp_node, const aiScene* scene,
+										   scene_source& source, const std::vector<material*>& materials, arena& storage,
+										   std::vector<std::function<void()>>& gl_tasks);
+	friend model_node* traverse_assimp_scene(const aiNode* curr, const aiScene* scene,
+											 scene_source& source, const std::vector<material*>& materials, arena& storage,
+											 std::vector<std::function<void()>>& gl_tasks);
+	friend void load_mesh_from_cooked_node(model_node** mesh_node, const cooked_node& node, const cooked_header* header,
+										   const std::vector<material*>& materials, std::vector<mesh*>& meshes,
+										   arena& storage, std::vector<std::function<void()>>& gl_tasks);
+	friend model_node* traverse_cooked_nodes(int index, const cooked_header* header, const std::vector<material*>& materials,
+											 std::vector<mesh*>& meshes, arena& storage, std::vector<std::function<void()>>& gl_tasks);
+	friend model_node* create_benchmark_hierarchy(int depth, int branching, std::mt19937& rng, arena& storage,
+												  const std::string& name, std::vector<std::string>& names);
+
+private:
+	model_node* next_sibling = nullptr;
 	model_node* first_child = nullptr;
 
-	mesh* m = nullptr;
-	material* mat = nullptr;
+	mesh* m = nullptr;
+	material* mat = nullptr;
+
+	matrix4 transform = identity();
+	matrix4 original_transform = identity();
+
+	std::string name;
+
+	vector3 pos;
+	quaternion rot;
+	vector3 scale;
+
+	// subtrees with fewer nodes are not worth handing to other threads
+	static const int parallel_subtree_size = 256;
+	int subtree_size = 1;
+};
+
+void mesh::pose(model_node* root, const matrix4& global_inverse)
+{
+	// the skinned vertices are blends of the bind pose boxes moved by each
+	// bone, so they stay within the box around all moved corners as long as
+	// the weights add up to one
+	vector3 min(HUGE_VALF, HUGE_VALF, HUGE_VALF);
+	vector3 max(-HUGE_VALF, -HUGE_VALF, -HUGE_VALF);
+
+	for (size_t i = 0; i < bones.size(); ++i)
+	{
+		model_node* bone_node = root->find(bones[i].node_ref);
+		palette[i] = global_inverse * bone_node->get_transform() * bones[i].transform;
+
+		if (bones[i].vertices.empty())
+		{
+			continue;
+		}
+
+		float corner_x[8];
+		float corner_y[8];
+		float corner_z[8];
+
+		for (int j = 0; j < 8; ++j)
+		{
+			corner_x[j] = j & 1 ? bones[i].bind_max.x : bones[i].bind_min.x;
+			corner_y[j] = j & 2 ? bones[i].bind_max.y : bones[i].bind_min.y;
+			corner_z[j] = j & 4 ? bones[i].bind_max.z : bones[i].bind_min.z;
+		}
+
+		float posed_x[8];
+		float posed_y[8];
+		float posed_z[8];
+
+		transform_vectors(palette[i], corner_x, corner_y, corner_z, posed_x, posed_y, posed_z, 8);
+
+		for (int j = 0; j < 8; ++j)
+		{
+			min = vector3(std::min(min.x, posed_x[j]), std::min(min.y, posed_y[j]), std::min(min.z, posed_z[j]));
+			max = vector3(std::max(max.x, posed_x[j]), std::max(max.y, posed_y[j]), std::max(max.z, posed_z[j]));
+		}
+	}
+
+	// no bone moves a vertex, skinning leaves them all at the origin
+	if (min.x > max.x)
+	{
+		min = vector3();
+		max = vector3();
+	}
+
+	// a vertex whose weights add up to s is s times a point in that box, so
+	// it is in the box scaled around the origin by some s between the
+	// smallest and the largest sum. a sum of 0 adds the origin.
+	vector3 scaled_min = min * min_weight_sum;
+	vector3 scaled_max = max * max_weight_sum;
+	min = vector3(std::min(min.x * max_weight_sum, scaled_min.x), std::min(min.y * max_weight_sum, scaled_min.y), std::min(min.z * max_weight_sum, scaled_min.z));
+	max = vector3(std::max(max.x * min_weight_sum, scaled_max.x), std::max(max.y * min_weight_sum, scaled_max.y), std::max(max.z * min_weight_sum, scaled_max.z));
+
+	bounds_center = (min + max) * 0.5f;
+	bounds_radius = vector_length(max - min) * 0.5f;
+}
+
+void mesh::skin(const frustum* view, const occlusion_buffer* occlusion)
+{
+	occluded = false;
+
+	if (view != nullptr && !sphere_in_frustum(*view, bounds_center, bounds_radius))
+	{
+		return;
+	}
+
+	if (occlusion != nullptr && occlusion->occluded(bounds()))
+	{
+		occluded = true;
+		return;
+	}
+
+	skinned_vertex_data.assign(vertex_data, vertex_data + vertex_cnt * layout.size);
+	std::fill(skinned_positions.begin(), skinned_positions.end(), vector3());
+	std::fill(skinned_normals.begin(), skinned_normals.end(), vector3());
+
+	for (std::vector<bone>::iterator iter = bones.begin(); iter != bones.end(); ++iter)
+	{
+		const matrix4& transform = palette[iter - bones.begin()];
+
+		int influence_cnt = static_cast<int>(iter->vertices.size());
+
+		transform_vectors_weighted(transform, iter->bind_x.data(), iter->bind_y.data(), iter->bind_z.data(),
+								   iter->weights.data(), skinned_x.data(), skinned_y.data(), skinned_z.data(),
+								   influence_cnt);
+
+		for (int i = 0; i < influence_cnt; ++i)
+		{
+			vector3& transformed_vertex = skinned_positions[iter->vertices[i].first];
+
+			transformed_vertex.x += skinned_x[i];
+			transformed_vertex.y += skinned_y[i];
+			transformed_vertex.z += skinned_z[i];
+		}
+
+		if (layout.normal_offset < 0)
+		{
+			continue;
+		}
+
+		// normals only follow the rotation
+		for (int i = 0; i < influence_cnt; ++i)
+		{
+			int vertex = iter->vertices[i].first;
+			vector3 normal = transform_direction(transform, read_normal(vertex_data + vertex * layout.size, layout));
+			vector3& transformed_normal = skinned_normals[vertex];
+
+			transformed_normal.x += iter->weights[i] * normal.x;
+			transformed_normal.y += iter->weights[i] * normal.y;
+			transformed_normal.z += iter->weights[i] * normal.z;
+		}
+	}
+
+	// written in the format the buffer is rendered with, quantized positions
+	// get the range of this pose
+	skinned_layout = gpu_vertex_layout(layout);
+
+	if (skinned_layout.position_format == format_quantized && vertex_cnt > 0)
+	{
+		vector3 min = skinned_positions[0];
+		vector3 max = min;
+
+		for (std::vector<vector3>::const_iterator iter = skinned_positions.begin(); iter != skinned_positions.end(); ++iter)
+		{
+			min = vector3(std::min(min.x, iter->x), std::min(min.y, iter->y), std::min(min.z, iter->z));
+			max = vector3(std::max(max.x, iter->x), std::max(max.y, iter->y), std::max(max.z, iter->z));
+		}
+
+		quantization_range(min, max, skinned_layout);
+	}
+
+	for (int i = 0; i < vertex_cnt; ++i)
+	{
+		uint8_t* vertex = skinned_vertex_data.data() + i * layout.size;
+		write_position(vertex, skinned_layout, skinned_positions[i]);
+
+		if (layout.normal_offset >= 0)
+		{
+			const vector3& n = skinned_normals[i];
+			float length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+			write_normal(vertex, skinned_layout, length > 0.0f ? vector3(n.x / length, n.y / length, n.z / length) : n);
+		}
+	}
+
+	skinned = true;
+}
+
+void mesh::upload()
+{
+	if (!skinned)
+	{
+		return;
+	}
+
+	skinned = false;
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	write_buffer(GL_ARRAY_BUFFER, base_vertex * layout.size, vertex_cnt * layout.size, skinned_vertex_data.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	gpu_layout = skinned_layout;
+}
+
+struct animation
+{
+	typedef std::vector<std::pair<double, vector3>> pos_key_list;
+	typedef std::vector<std::pair<double, quaternion>> rot_key_list;
+	typedef std::vector<std::pair<double, vector3>> scale_key_list;
+
+	std::string node_ref;
+	// .x file format and wme both actually use a 32 bit integer for time
+	pos_key_list pos_keys;
+	rot_key_list rot_keys;
+	scale_key_list scale_keys;
+	double local_time = 0.0f;
+
+	void update(double local_time, model_node* node)
+	{
+		vector3 pos = update_positions(local_time);
+		quaternion rot = update_rotations(local_time);
+		vector3 scale = update_scalings(local_time);
+
+		node->set_transform_data(pos, rot, scale);
+	}
+
+	// this is three times the same algorithm, do something generic here
+	vector3 update_positions(double local_time)
+	{
+		if (pos_keys.size () < 2)
+		{
+			return (vector3(0.0f, 0.0f, 0.0f));
+		}
+
+		pos_key_list::iterator key1 = pos_keys.end();
+		pos_key_list::iterator key2 = pos_keys.end();
+
+		for (pos_key_list::iterator iter = pos_keys.begin(); iter < pos_keys.end(); ++iter)
+		{
+			if (iter->first / 1000.0f > local_time)
+			{
+				// wme does something different here, not sure why
+				key1 = iter;
+				key2 = iter + 1;
+				break;
+			}
+		}
+
+		if (key1 == pos_keys.end() || key2 == pos_keys.end())
+		{
+			return pos_keys.back().second;
+		}
+
+		float lerp = (key1->first - local_time) / (key2->first - key1->first);
+		return linear_interpolation(key1->second, key2->second, lerp);
+	}
+
+	quaternion update_rotations(double local_time)
+	{
+		if (rot_keys.size() < 2)
+		{
+			return quaternion(0.0f, 0.0f, 0.0f, 1.0f);
+		}
+
+		rot_key_list::iterator key1 = rot_keys.end();
+		rot_key_list::iterator key2 = rot_keys.end();
+
+		for (rot_key_list::iterator iter = rot_keys.begin(); iter < rot_keys.end(); ++iter)
+		{
+			if (iter->first / 1000.0f > local_time)
+			{
+				// wme does something different here, not sure why
+				key1 = iter;
+				key2 = iter + 1;
+				break;
+			}
+		}
+
+		if (key1 == rot_keys.end() || key2 == rot_keys.end())
+		{
+			return rot_keys.back().second;
+		}
+
+		float lerp = (key1->first - local_time) / (key2->first - key1->first);
+
+		quaternion q1 (key1->second.w, -key1->second.x, -key1->second.y, -key1->second.z);
+		quaternion q2 (key2->second.w, -key2->second.x, -key2->second.y, -key2->second.z);
+
+		return spherical_linear_interpolation(q1, q2, lerp);
+	}
+
+	vector3 update_scalings(double local_time)
+	{
+		if (scale_keys.size() < 2)
+		{
+			return vector3(1.0f, 1.0, 1.0f);
+		}
+
+		scale_key_list::iterator key1;
+		scale_key_list::iterator key2;
+
+		for (scale_key_list::iterator iter = scale_keys.begin(); iter < scale_keys.end(); ++iter)
+		{
+			if (iter->first > local_time)
+			{
+				// wme does something different here, not sure why
+				key1 = iter;
+				key2 = iter + 1;
+				break;
+			}
+		}
+
+		float lerp = (key1->first - local_time) / (key2->first - key1->first);
+		return linear_interpolation(key1->second, key2->second, lerp);
+	}
+
+	double total_time()
+	{
+		// wme does the same here, appearently the total time
+		// is not contained in the .x file format
+		double ret = 0.0;
+
+		if (!pos_keys.empty())
+		{
+			ret = std::max(ret, pos_keys.back().first);
+		}
+
+		if (!rot_keys.empty())
+		{
+			ret = std::max(ret, rot_keys.back().first);
+		}
+
+		if (!scale_keys.empty())
+		{
+			ret = std::max(ret, scale_keys.back().first);
+		}
+
+		return ret;
+	}
+};
+
+typedef std::pair<std::string, std::vector<animation>> animation_set;
+
+class model
+{
+public:
+	// takes ownership of storage, which holds the nodes, meshes and materials
+	model(arena* storage, model_node* root, matrix4 global_inverse, const std::vector<animation_set>& anim_sets, double ticks_per_second)
+		: storage(storage), root(root), global_inverse(global_inverse), animation_sets(anim_sets), ticks_per_second(ticks_per_second)
+	{
+		if (root)
+		{
+			root->update_subtree_size();
+
+			// nodes may share a mesh, which only has to be skinned and
+			// uploaded once per frame
+			std::vector<mesh*> references;
+			root->collect_meshes(references);
+
+			for (std::vector<mesh*>::iterator iter = references.begin(); iter != references.end(); ++iter)
+			{
+				std::vector<std::pair<mesh*, int>>::iterator found = std::find_if(meshes.begin(), meshes.end(),
+					[&](const std::pair<mesh*, int>& entry) { return entry.first == *iter; });
+
+				if (found != meshes.end())
+				{
+					++found->second;
+				}
+				else
+				{
+					meshes.push_back(std::make_pair(*iter, 1));
+				}
+			}
+		}
+	}
+
+	model(const model& ) = delete;
+	model& operator=(const model& ) = delete;
+
+	model(model&& other)
+	{
+		storage = other.storage;
+		root = other.root;
+		meshes.swap(other.meshes);
+		other.storage = nullptr;
+		other.root = nullptr;
+	}
+
+	model& operator=(model&& other)
+	{
+		std::swap(storage, other.storage);
+		std::swap(root, other.root);
+		meshes.swap(other.meshes);
+		return *this;
+	}
+
+	~model()
+	{
+		if (storage)
+		{
+			delete storage;
+		}
+	}
+
+	// draws the meshes right away in tree order
+	void render(render_view& view)
+	{
+		if (root)
+		{
+			view.modelview = gl_matrix(GL_MODELVIEW_MATRIX);
+			view.view_frustum = gl_view_frustum();
+			root->render(view);
+		}
+	}
+
+	// adds the meshes to queue, which draws them sorted by state
+	void render(render_view& view, render_queue& queue)
+	{
+		if (root)
+		{
+			view.modelview = gl_matrix(GL_MODELVIEW_MATRIX);
+			view.view_frustum = gl_view_frustum();
+			root->queue(view, queue);
+		}
+	}
+
+	void update(float delta, const frustum* view = nullptr)
+	{
+		animate(delta, nullptr, view);
+		upload();
+	}
+
+	// advances the animation and recomputes transforms and skinned vertices,
+	// meshes outside of view are not skinned. touches nothing outside this
+	// model and no GL state, so different models can be animated on
+	// different threads.
+	void animate(float delta, worker_pool* pool = nullptr, const frustum* view = nullptr)
+	{
+		pose(delta, pool);
+		skin(view);
+	}
+
+	// the first half of animate(), advances the animation and recomputes
+	// the transforms and mesh bounds
+	void pose(float delta, worker_pool* pool = nullptr)
+	{
+		local_time += delta;
+		//local_time *= (ticks_per_second / 1000.0);
+
+		if (local_time > 4800.0 / 1000.0)
+		{
+			local_time = 0.0;
+		}
+
+		for (std::vector<animation>::iterator iter = curr_anim->second.begin();
+			 iter != curr_anim->second.end(); ++iter)
+		{
+			model_node* target = find_node(iter->node_ref);
+
+			if (target != nullptr)
+			{
+				iter->update(local_time, target);
+			}
+		}
+
+		root->update_transform(identity(), pool);
+
+		for (std::vector<std::pair<mesh*, int>>::iterator iter = meshes.begin(); iter != meshes.end(); ++iter)
+		{
+			iter->first->pose(root, global_inverse);
+		}
+	}
+
+	// the second half of animate(), skins the meshes that are in view and
+	// not occluded
+	void skin(const frustum* view = nullptr, const occlusion_buffer* occlusion = nullptr)
+	{
+		for (std::vector<std::pair<mesh*, int>>::iterator iter = meshes.begin(); iter != meshes.end(); ++iter)
+		{
+			iter->first->skin(view, occlusion);
+		}
+	}
+
+	// draws the meshes skinned this frame into occlusion
+	void rasterize_occluders(occlusion_buffer& occlusion) const
+	{
+		for (std::vector<std::pair<mesh*, int>>::const_iterator iter = meshes.begin(); iter != meshes.end(); ++iter)
+		{
+			iter->first->rasterize_occluder(occlusion);
+		}
+	}
+
+	// occluders are skinned and drawn into the occlusion buffer before the
+	// other models are tested against it, see update_models
+	void set_occluder(bool occluder)
+	{
+		this->occluder = occluder;
+	}
+
+	bool is_occluder() const
+	{
+		return occluder;
+	}
+
+	void upload()
+	{
+		for (std::vector<std::pair<mesh*, int>>::iterator iter = meshes.begin(); iter != meshes.end(); ++iter)
+		{
+			iter->first->upload();
+		}
+	}
+
+	void play_anim(const std::string& name)
+	{
+		for (std::vector<animation_set>::iterator iter = animation_sets.begin(); iter < animation_sets.end(); ++iter)
+		{
+			if (iter->first == name)
+			{
+				curr_anim = &(*iter);
+			}
+		}
+	}
+
+	model_node* find_node(const std::string& ref)
+	{
+		if (root != nullptr)
+		{
+			return root->find(ref);
+		}
+
+		return nullptr;
+	}
+
+	const arena* get_storage() const
+	{
+		return storage;
+	}
+
+	// suballocates the meshes from the buffers of pool, which must outlive
+	// the model. must be called before the meshes create their buffers.
+	void share_buffers(geometry_pool& pool)
+	{
+		for (std::vector<std::pair<mesh*, int>>::iterator iter = meshes.begin(); iter != meshes.end(); ++iter)
+		{
+			pool.add(iter->first);
+		}
+	}
+
+	// the same with a pool owned by the model
+	geometry_pool* share_buffers()
+	{
+		geometry_pool* ret = storage->create<geometry_pool>();
+		share_buffers(*ret);
+		return ret;
+	}
+
+	// bounds of all meshes in the last pose, what instances of this model
+	// are culled and picked by
+	bounding_box bounds() const
+	{
+		bounding_box ret;
+
+		for (std::vector<std::pair<mesh*, int>>::const_iterator iter = meshes.begin(); iter != meshes.end(); ++iter)
+		{
+			ret.add(iter->first->bounds());
+		}
+
+		return ret;
+	}
+
+	int mesh_count() const
+	{
+		return static_cast<int>(meshes.size());
+	}
+
+	// number of nodes that reference a mesh, at least mesh_count()
+	int mesh_reference_count() const
+	{
+		int ret = 0;
+
+		for (std::vector<std::pair<mesh*, int>>::const_iterator iter = meshes.begin(); iter != meshes.end(); ++iter)
+		{
+			ret += iter->second;
+		}
+
+		return ret;
+	}
+
+	// memory a separate mesh per referencing node would have taken in addition
+	void shared_mesh_savings(size_t& gpu_bytes, size_t& cpu_bytes) const
+	{
+		gpu_bytes = 0;
+		cpu_bytes = 0;
+
+		for (std::vector<std::pair<mesh*, int>>::const_iterator iter = meshes.begin(); iter != meshes.end(); ++iter)
+		{
+			gpu_bytes += (iter->second - 1) * iter->first->gpu_bytes();
+			cpu_bytes += (iter->second - 1) * iter->first->cpu_bytes();
+		}
+	}
+
+private:
+	arena* storage = nullptr;
+	model_node* root = nullptr;
+	// every mesh once, with the number of nodes referencing it
+	std::vector<std::pair<mesh*, int>> meshes;
+	matrix4 global_inverse;
+	std::vector<animation_set> animation_sets;
+	animation_set* curr_anim;
+	double ticks_per_second = 4800.0; // x. and wme use an 32-bit integer
+	float local_time = 0.0f;
+	bool occluder = false;
+};
+
+// updates all models for one frame. the CPU side runs on the pool, one model
+// per task, then the results are uploaded from the calling (GL) thread.
+// models are independent of each other, so the output does not depend on
+// the number of threads or the scheduling. view is the frustum the models
+// will be rendered with, or null to skin every mesh.
+//
+// with an occlusion buffer, cleared by the caller for this frame, the
+// occluder models are skinned first and drawn into it, then the other
+// models skip the meshes hidden behind them.
+void update_models(const std::vector<model*>& models, float delta, worker_pool& pool, const frustum* view = nullptr,
+				   occlusion_buffer* occlusion = nullptr)
+{
+	pool.parallel_for(static_cast<int>(models.size()), [&](int i)
+	{
+		models[i]->pose(delta, &pool);
+
+		if (occlusion == nullptr || models[i]->is_occluder())
+		{
+			models[i]->skin(view);
+		}
+	});
+
+	if (occlusion != nullptr)
+	{
+		// the buffer is not thread safe, the occluders are few
+		for (std::vector<model*>::const_iterator iter = models.begin(); iter != models.end(); ++iter)
+		{
+			if ((*iter)->is_occluder())
+			{
+				(*iter)->rasterize_occluders(*occlusion);
+			}
+		}
+
+		pool.parallel_for(static_cast<int>(models.size()), [&](int i)
+		{
+			if (!models[i]->is_occluder())
+			{
+				models[i]->skin(view, occlusion);
+			}
+		});
+	}
+
+	for (std::vector<model*>::const_iterator iter = models.begin(); iter != models.end(); ++iter)
+	{
+		(*iter)->upload();
+	}
+}
+
+struct image
+{
+	std::vector<uint8_t> pixels;
+	int width = 0;
+	int height = 0;
+};
+
+// reads file into RGBA pixels with the first row at the bottom, like GL
+// expects them. does not touch GL, so it can run on any thread.
+bool decode_texture(const char* file, image& out)
+{
+	int width = 0;
+	int height = 0;
+	int compression = 0;
+
+	uint8_t* data = stbi_load(file, &width, &height, &compression, STBI_rgb_alpha);
+
+	if (data == nullptr)
+	{
+		std::cout << stbi_failure_reason() << std::endl;
+		return false;
+	}
+
+	out.pixels.resize(width * height * 4);
+	out.width = width;
+	out.height = height;
+	uint8_t* data_fixed = out.pixels.data();
+
+	for (int i = 0; i < width * 4; i += 4)
+	{
+		for (int j = 0; j < height; ++j)
+		{
+			data_fixed[j * width * 4 + i] = data[(height - j - 1) * width * 4 + i];
+			data_fixed[j * width * 4 + i + 1] = data[(height - j - 1) * width * 4 + i + 1];
+			data_fixed[j * width * 4 + i + 2] = data[(height - j - 1) * width * 4 + i + 2];
+			data_fixed[j * width * 4 + i + 3] = data[(height - j - 1) * width * 4 + i + 3];
+		}
+	}
+
+	stbi_image_free(data);
+	return true;
+}
+
+// GL work left over by loading a model, has to run in order on the GL thread
+// before the model is used
+typedef std::vector<std::function<void()>> gl_task_list;
+
+void run_gl_tasks(gl_task_list& tasks)
+{
+	for (gl_task_list::iterator iter = tasks.begin(); iter != tasks.end(); ++iter)
+	{
+		(*iter)();
+	}
+
+	tasks.clear();
+}
+
+// queues the upload of img to tex
+void queue_texture_upload(texture* tex, image&& img, gl_task_list& gl_tasks)
+{
+	std::shared_ptr<image> pixels = std::make_shared<image>(std::move(img));
+
+	gl_tasks.push_back([tex, pixels]()
+	{
+		tex->upload(pixels->pixels.data(), pixels->width, pixels->height);
+	});
+}
+
+// decodes file right away, the upload is queued to gl_tasks
+texture* load_texture(const char* file, arena& storage, gl_task_list& gl_tasks)
+{
+	image img;
+
+	if (!decode_texture(file, img))
+	{
+		return nullptr;
+	}
+
+	texture* tex = storage.create<texture>();
+	queue_texture_upload(tex, std::move(img), gl_tasks);
+	return tex;
+}
+
+material* create_material(const cooked_material& source, texture* tex, arena& storage)
+{
+	material* mat = storage.create<material>();
+	std::copy(source.diffuse, source.diffuse + 4, mat->diffuse);
+	std::copy(source.emissive, source.emissive + 4, mat->emissive);
+	std::copy(source.ambient, source.ambient + 4, mat->ambient);
+	std::copy(source.specular, source.specular + 4, mat->specular);
+	mat->shininess = source.shininess;
+	mat->tex = tex;
+	return mat;
+}
+
+// everything needed from one aiMesh, prepared without touching GL
+struct mesh_source
+{
+	uint8_t* vertex_data = nullptr;
+	uint8_t* index_data = nullptr;
+	vertex_layout layout;
+	int vertex_count = 0;
+	int index_count = 0;
+	int index_size = 0;
+	// all levels of detail, until they are packed into index_data
+	std::vector<uint32_t> indices;
+	std::vector<mesh_lod> lods;
+	std::vector<bone> bones;
+	// created by the first node that references the aiMesh, shared by all
+	// others
+	mesh* instance = nullptr;
+};
+
+// the same for one aiMaterial, including the decoded texture
+struct material_source
+{
+	cooked_material data;
+	std::string texture_path;
+	image tex_image;
+};
+
+// result of the CPU phase of loading an aiScene, indexed like
+// scene->mMeshes and scene->mMaterials
+struct scene_source
+{
+	std::vector<mesh_source> meshes;
+	std::vector<material_source> materials;
+};
+
+void extract_assimp_mesh(const aiMesh* m, mesh_source& out)
+{
+	std::vector<uint32_t> remap;
+	out.indices = optimize_assimp_mesh(m, remap, out.lods);
+	out.index_count = static_cast<int>(out.indices.size());
+	pack_assimp_vertices(m, out.layout, out.vertex_data, remap.data());
+
+	for (aiBone** iter = m->mBones; iter < m->mBones + m->mNumBones; ++iter)
+	{
+		out.bones.push_back(bone());
+		out.bones.back().node_ref = (*iter)->mName.C_Str();
+
+		for (aiVertexWeight* iter2 = (*iter)->mWeights; iter2 < (*iter)->mWeights + (*iter)->mNumWeights; ++iter2)
+		{
+			out.bones.back().vertices.push_back(std::make_pair(remap[iter2->mVertexId], iter2->mWeight));
+		}
+
+		out.bones.back().transform = convert_assimp_matrix((*iter)->mOffsetMatrix);
+	}
+
+	gather_bind_pose(out.bones, out.vertex_data, out.layout);
+}
+
+// CPU phase: converts all meshes and materials of scene, on pool if given.
+// the vertices store vertex_attributes where the mesh has them. the arena is
+// not thread safe, so all of its memory is taken up front.
+scene_source extract_assimp_scene(const aiScene* scene, unsigned vertex_attributes, arena& storage, worker_pool* pool)
+{
+	scene_source ret;
+	ret.meshes.resize(scene->mNumMeshes);
+	ret.materials.resize(scene->mNumMaterials);
+
+	for (unsigned i = 0; i < scene->mNumMeshes; ++i)
+	{
+		mesh_source& m = ret.meshes[i];
+		m.layout = choose_vertex_layout(scene, scene->mMeshes[i], vertex_attributes);
+		m.vertex_count = scene->mMeshes[i]->mNumVertices;
+		m.index_size = index_size_for(m.vertex_count);
+
+		// the index data is only allocated once the number of indices of
+		// all levels of detail is known
+		if (m.vertex_count > 0 && scene->mMeshes[i]->mNumFaces > 0)
+		{
+			m.vertex_data = static_cast<uint8_t*>(storage.allocate(m.vertex_count * m.layout.size, alignof(float)));
+		}
+	}
+
+	int mesh_count = static_cast<int>(scene->mNumMeshes);
+	std::function<void(int)> extract = [&](int i)
+	{
+		if (i < mesh_count)
+		{
+			if (ret.meshes[i].vertex_data != nullptr)
+			{
+				extract_assimp_mesh(scene->mMeshes[i], ret.meshes[i]);
+			}
+
+			return;
+		}
+
+		material_source& mat = ret.materials[i - mesh_count];
+		mat.texture_path = read_assimp_material(scene->mMaterials[i - mesh_count], mat.data);
+
+		if (!mat.texture_path.empty())
+		{
+			decode_texture(mat.texture_path.c_str(), mat.tex_image);
+		}
+	};
+
+	int count = mesh_count + static_cast<int>(scene->mNumMaterials);
+
+	if (pool != nullptr)
+	{
+		pool->parallel_for(count, extract);
+	}
+	else
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			extract(i);
+		}
+	}
+
+	for (std::vector<mesh_source>::iterator iter = ret.meshes.begin(); iter != ret.meshes.end(); ++iter)
+	{
+		if (iter->vertex_data != nullptr)
+		{
+			// aligned for the index type
+			iter->index_data = static_cast<uint8_t*>(storage.allocate(iter->indices.size() * iter->index_size, iter->index_size));
+			pack_indices(iter->indices, iter->index_data, iter->index_size);
+			std::vector<uint32_t>().swap(iter->indices);
+		}
+	}
+
+	return ret;
+}
+
+// the texture uploads of the decoded images are queued to gl_tasks
+std::vector<material*> create_materials(scene_source& source, arena& storage, gl_task_list& gl_tasks)
+{
+	std::vector<material*> ret;
+
+	for (std::vector<material_source>::iterator iter = source.materials.begin(); iter != source.materials.end(); ++iter)
+	{
+		texture* tex = nullptr;
+
+		if (!iter->tex_image.pixels.empty())
+		{
+			tex = storage.create<texture>();
+			queue_texture_upload(tex, std::move(iter->tex_image), gl_tasks);
+		}
+
+		ret.push_back(create_material(iter->data, tex, storage));
+	}
+
+	return ret;
+}
+
+void load_mesh_from_assimp_node(model_node** mesh_node, const aiNode* assimp_node, const aiScene* scene,
+								scene_source& source, const std::vector<material*>& materials, arena& storage,
+								gl_task_list& gl_tasks)
+{
+	for (const unsigned* iter = assimp_node->mMeshes; iter < assimp_node->mMeshes + assimp_node->mNumMeshes; ++iter)
+	{
+		mesh_source& m = source.meshes[*iter];
+
+		if (m.vertex_data == nullptr)
+		{
+			continue;
+		}
+
+		if (m.instance == nullptr)
+		{
+			m.instance = storage.create<mesh>(m.vertex_data, m.vertex_count, m.layout,
+											  m.index_data, m.index_count, m.index_size, m.lods,
+											  std::move(m.bones));
+			gl_tasks.push_back(std::bind(&mesh::create_buffers, m.instance));
+		}
+
+		*mesh_node = storage.create<model_node>();
+		(*mesh_node)->m = m.instance;
+		(*mesh_node)->mat = materials[scene->mMeshes[*iter]->mMaterialIndex];
+		mesh_node = &(*mesh_node)->next_sibling;
+	}
+}
+
+model_node* traverse_assimp_scene(const aiNode* curr, const aiScene* scene,
+								  scene_source& source, const std::vector<material*>& materials, arena& storage,
+								  gl_task_list& gl_tasks)
+{
+	model_node* ret = storage.create<model_node>();
+	model_node** curr_child = &ret->first_child;
+
+	for (aiNode** iter = curr->mChildren;  iter < curr->mChildren + curr->mNumChildren; ++iter)
+	{
+		*curr_child = traverse_assimp_scene(*iter, scene, source, materials, storage, gl_tasks);
+		curr_child = &((*curr_child)->next_sibling);
+	}
+
+	load_mesh_from_assimp_node(curr_child, curr, scene, source, materials, storage, gl_tasks);
+	ret->name = curr->mName.C_Str();
+
+	ret->transform = convert_assimp_matrix(curr->mTransformation);
+	ret->original_transform = ret->transform;
+
+	return ret;
+}
+
+size_t estimate_node_size(const aiNode* node)
+{
+	size_t ret = (node->mNumMeshes + 1) * (sizeof(model_node) + alignof(model_node));
+
+	for (aiNode** iter = node->mChildren; iter < node->mChildren + node->mNumChildren; ++iter)
+	{
+		ret += estimate_node_size(*iter);
+	}
+
+	return ret;
+}
+
+// rough upper bound for the arena memory needed by scene, so a model usually
+// ends up in a single block. meshes and materials exist once no matter how
+// many nodes reference them.
+size_t estimate_model_size(const aiScene* scene, unsigned vertex_attributes)
+{
+	size_t ret = estimate_node_size(scene->mRootNode);
+
+	for (unsigned i = 0; i < scene->mNumMeshes; ++i)
+	{
+		const aiMesh* m = scene->mMeshes[i];
+		// the levels of detail take less than the full mesh again
+		ret += m->mNumVertices * choose_vertex_layout(scene, m, vertex_attributes).size + 2 * m->mNumFaces * 3 * index_size_for(m->mNumVertices);
+		ret += sizeof(mesh) + 3 * alignof(std::max_align_t);
+	}
+
+	ret += scene->mNumMaterials * (sizeof(material) + sizeof(texture) + 2 * alignof(std::max_align_t));
+	return ret;
+}
+
+// builds the model without touching GL, which is left to gl_tasks. the
+// expensive conversion of meshes and materials runs on pool if one is given.
+model* prepare_assimp_scene(const aiScene* scene, unsigned vertex_attributes, worker_pool* pool, gl_task_list& gl_tasks)
+{
+	arena* storage = new arena(estimate_model_size(scene, vertex_attributes));
+	scene_source source = extract_assimp_scene(scene, vertex_attributes, *storage, pool);
+	std::vector<material*> materials = create_materials(source, *storage, gl_tasks);
+	model_node* root = traverse_assimp_scene(scene->mRootNode, scene, source, materials, *storage, gl_tasks);
+	std::vector<animation_set> anim_sets;
+
+	// Inverse() works in place, so invert a copy
+	aiMatrix4x4 ai_global_inverse = scene->mRootNode->mTransformation;
+	ai_global_inverse.Inverse();
+	matrix4 global_inverse;
+
+	global_inverse = convert_assimp_matrix(ai_global_inverse);
+	double ticks_per_second = 0.0;
+
+	for (aiAnimation** iter = scene->mAnimations; iter < scene->mAnimations + scene->mNumAnimations; ++iter)
+	{
+		anim_sets.resize(anim_sets.size() + 1);
+		anim_sets.back().first = std::string((*iter)->mName.C_Str());
+		ticks_per_second = (*iter)->mTicksPerSecond;
+
+		for (aiNodeAnim** iter2 = (*iter)->mChannels; iter2 < (*iter)->mChannels + (*iter)->mNumChannels; ++iter2)
+		{
+			anim_sets.back().second.push_back(animation());
+			anim_sets.back().second.back().node_ref = std::string((*iter2)->mNodeName.C_Str());
+
+			for (aiVectorKey* iter3 = (*iter2)->mPositionKeys; iter3 < (*iter2)->mPositionKeys + (*iter2)->mNumPositionKeys; ++iter3)
+			{
+				anim_sets.back().second.back().pos_keys.resize(anim_sets.back().second.back().pos_keys.size() + 1);
+				anim_sets.back().second.back().pos_keys.back().first = iter3->mTime;
+				anim_sets.back().second.back().pos_keys.back().second.x = iter3->mValue.x;
+				anim_sets.back().second.back().pos_keys.back().second.y = iter3->mValue.y;
+				anim_sets.back().second.back().pos_keys.back().second.z = iter3->mValue.z;
+			}
+
+			for (aiVectorKey* iter3 = (*iter2)->mScalingKeys; iter3 < (*iter2)->mScalingKeys + (*iter2)->mNumScalingKeys; ++iter3)
+			{
+				anim_sets.back().second.back().scale_keys.resize(anim_sets.back().second.back().scale_keys.size() + 1);
+				anim_sets.back().second.back().scale_keys.back().first = iter3->mTime;
+				anim_sets.back().second.back().scale_keys.back().second.x = iter3->mValue.x;
+				anim_sets.back().second.back().scale_keys.back().second.y = iter3->mValue.y;
+				anim_sets.back().second.back().scale_keys.back().second.z = iter3->mValue.z;
+			}
+
+			for (aiQuatKey* iter3 = (*iter2)->mRotationKeys; iter3 < (*iter2)->mRotationKeys + (*iter2)->mNumRotationKeys; ++iter3)
+			{
+				anim_sets.back().second.back().rot_keys.resize(anim_sets.back().second.back().rot_keys.size() + 1);
+				anim_sets.back().second.back().rot_keys.back().first = iter3->mTime;
+				anim_sets.back().second.back().rot_keys.back().second.w = iter3->mValue.w;
+				anim_sets.back().second.back().rot_keys.back().second.x = iter3->mValue.x;
+				anim_sets.back().second.back().rot_keys.back().second.y = iter3->mValue.y;
+				anim_sets.back().second.back().rot_keys.back().second.z = iter3->mValue.z;
+			}
+		}
+	}
+
+	return new model(storage, root, global_inverse, anim_sets, ticks_per_second);
+}
+
+model* load_from_assimp_scene(const aiScene* scene, worker_pool* pool = nullptr,
+							  unsigned vertex_attributes = default_vertex_attributes)
+{
+	gl_task_list gl_tasks;
+	model* ret = prepare_assimp_scene(scene, vertex_attributes, pool, gl_tasks);
+	run_gl_tasks(gl_tasks);
+	return ret;
+}
+
+// meshes is indexed like header->meshes, the first node referencing a mesh
+// creates it and all others share it
+void load_mesh_from_cooked_node(model_node** mesh_node, const cooked_node& node, const cooked_header* header,
+								const std::vector<material*>& materials, std::vector<mesh*>& meshes,
+								arena& storage, gl_task_list& gl_tasks)
+{
+	for (uint32_t i = 0; i < node.mesh_count; ++i)
+	{
+		const cooked_mesh& m = header->meshes.ptr[node.meshes.ptr[i]];
+		mesh*& instance = meshes[node.meshes.ptr[i]];
+
+		if (m.vertex_count == 0 || m.index_count == 0)
+		{
+			continue;
+		}
+
+		if (instance != nullptr)
+		{
+			*mesh_node = storage.create<model_node>();
+			(*mesh_node)->m = instance;
+			(*mesh_node)->mat = materials[m.material];
+			mesh_node = &(*mesh_node)->next_sibling;
+			continue;
+		}
+
+		std::vector<bone> bones(m.bone_count);
+
+		for (uint32_t j = 0; j < m.bone_count; ++j)
+		{
+			const cooked_bone& b = m.bones.ptr[j];
+			bones[j].node_ref = b.node_ref.ptr;
+			bones[j].transform = b.offset;
+
+			for (const cooked_influence* iter = b.influences.ptr; iter < b.influences.ptr + b.influence_count; ++iter)
+			{
+				bones[j].vertices.push_back(std::make_pair(iter->vertex, iter->weight));
+			}
+		}
+
+		// the mesh uses the vertex and index data right from the mapped file
+		instance = storage.create<mesh>(m.vertices.ptr, m.vertex_count, m.layout,
+										m.indices.ptr, m.index_count, static_cast<int>(m.index_size),
+										std::vector<mesh_lod>(m.lods.ptr, m.lods.ptr + m.lod_count),
+										std::move(bones));
+		gl_tasks.push_back(std::bind(&mesh::create_buffers, instance));
+
+		*mesh_node = storage.create<model_node>();
+		(*mesh_node)->m = instance;
+		(*mesh_node)->mat = materials[m.material];
+		mesh_node = &(*mesh_node)->next_sibling;
+	}
+}
+
+model_node* traverse_cooked_nodes(int index, const cooked_header* header, const std::vector<material*>& materials,
+								  std::vector<mesh*>& meshes, arena& storage, gl_task_list& gl_tasks)
+{
+	const cooked_node& node = header->nodes.ptr[index];
+
+	model_node* ret = storage.create<model_node>();
+	model_node** curr_child = &ret->first_child;
+
+	for (int child = node.first_child; child >= 0; child = header->nodes.ptr[child].next_sibling)
+	{
+		*curr_child = traverse_cooked_nodes(child, header, materials, meshes, storage, gl_tasks);
+		curr_child = &((*curr_child)->next_sibling);
+	}
+
+	load_mesh_from_cooked_node(curr_child, node, header, materials, meshes, storage, gl_tasks);
+	ret->name = node.name.ptr;
+
+	ret->transform = node.transform;
+	ret->original_transform = ret->transform;
+
+	return ret;
+}
+
+std::vector<std::pair<double, vector3>> convert_cooked_keys(const cooked_vector_key* keys, uint32_t count)
+{
+	std::vector<std::pair<double, vector3>> ret;
+
+	for (const cooked_vector_key* iter = keys; iter < keys + count; ++iter)
+	{
+		ret.push_back(std::make_pair(iter->time, iter->value));
+	}
+
+	return ret;
+}
+
+// maps a file written by cook_scene and builds the model without touching GL,
+// which is left to gl_tasks. returns nullptr if the file is missing or not a
+// valid cooked model.
+model* prepare_cooked_model(const char* path, gl_task_list& gl_tasks)
+{
+	arena* storage = new arena(64 * 1024);
+	mapped_file* file = storage->create<mapped_file>(path);
+	const cooked_header* header = map_cooked_model(*file);
+
+	if (header == nullptr)
+	{
+		std::cout << path << " is not a valid cooked model" << std::endl;
+		delete storage;
+		return nullptr;
+	}
+
+	std::vector<material*> materials;
+
+	for (uint32_t i = 0; i < header->material_count; ++i)
+	{
+		const cooked_material& mat_data = header->materials.ptr[i];
+		texture* tex = mat_data.texture_path.ptr != nullptr ? load_texture(mat_data.texture_path.ptr, *storage, gl_tasks) : nullptr;
+		materials.push_back(create_material(mat_data, tex, *storage));
+	}
+
+	std::vector<mesh*> meshes(header->mesh_count, nullptr);
+	model_node* root = traverse_cooked_nodes(0, header, materials, meshes, *storage, gl_tasks);
+	std::vector<animation_set> anim_sets(header->animation_count);
+
+	for (uint32_t i = 0; i < header->animation_count; ++i)
+	{
+		const cooked_animation& anim = header->animations.ptr[i];
+		anim_sets[i].first = anim.name.ptr;
+		anim_sets[i].second.resize(anim.channel_count);
+
+		for (uint32_t j = 0; j < anim.channel_count; ++j)
+		{
+			const cooked_channel& channel = anim.channels.ptr[j];
+			animation& target = anim_sets[i].second[j];
+			target.node_ref = channel.node_ref.ptr;
+			target.pos_keys = convert_cooked_keys(channel.pos_keys.ptr, channel.pos_key_count);
+			target.scale_keys = convert_cooked_keys(channel.scale_keys.ptr, channel.scale_key_count);
+
+			for (const cooked_quat_key* iter = channel.rot_keys.ptr; iter < channel.rot_keys.ptr + channel.rot_key_count; ++iter)
+			{
+				target.rot_keys.push_back(std::make_pair(iter->time, iter->value));
+			}
+		}
+	}
+
+	return new model(storage, root, header->global_inverse, anim_sets, header->ticks_per_second);
+}
+
+model* load_cooked_model(const char* path)
+{
+	gl_task_list gl_tasks;
+	model* ret = prepare_cooked_model(path, gl_tasks);
+	run_gl_tasks(gl_tasks);
+	return ret;
+}
+
+// how files are imported with Assimp
+struct import_options
+{
+	unsigned flags = default_import_flags;
+	// what the vertices store, see choose_vertex_layout
+	unsigned vertex_attributes = default_vertex_attributes;
+	// runs the post-processing steps one at a time and prints how long
+	// each of them and the conversion took
+	bool time_stages = false;
+	// the meshes of a model share one vertex and index buffer per vertex
+	// format, only set if base_vertex_available()
+	bool shared_buffers = false;
+};
+
+// post-processing steps in the order Assimp runs them, so applying them one
+// at a time gives the same scene as passing all of them to ReadFile
+const std::pair<unsigned, const char*> import_stages[] =
+{
+	std::make_pair(aiProcess_ValidateDataStructure, "validate"),
+	std::make_pair(aiProcess_RemoveRedundantMaterials, "remove redundant materials"),
+	std::make_pair(aiProcess_OptimizeMeshes, "optimize meshes"),
+	std::make_pair(aiProcess_Triangulate, "triangulate"),
+	std::make_pair(aiProcess_SortByPType, "sort by primitive type"),
+	std::make_pair(aiProcess_FindInvalidData, "find invalid data"),
+	std::make_pair(aiProcess_GenSmoothNormals, "smooth normals"),
+	std::make_pair(aiProcess_CalcTangentSpace, "tangent space"),
+	std::make_pair(aiProcess_JoinIdenticalVertices, "join identical vertices"),
+	std::make_pair(aiProcess_LimitBoneWeights, "limit bone weights"),
+	std::make_pair(aiProcess_ImproveCacheLocality, "improve cache locality")
+};
+
+double elapsed_ms(std::chrono::steady_clock::time_point begin)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// ReadFile with the flags from options, prints errors and the stage timings
+const aiScene* import_scene(Assimp::Importer& importer, const std::string& path, const import_options& options)
+{
+	if (!options.time_stages)
+	{
+		const aiScene* ret = importer.ReadFile(path, options.flags);
+
+		if (ret == nullptr)
+		{
+			std::cout << "could not import " << path << ": " << importer.GetErrorString() << std::endl;
+		}
+
+		return ret;
+	}
+
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	const aiScene* ret = importer.ReadFile(path, 0);
+	std::cout << "import " << path << std::endl;
+	std::cout << "  read: " << elapsed_ms(begin) << " ms" << std::endl;
+
+	unsigned remaining = options.flags;
+
+	for (size_t i = 0; ret != nullptr && i < sizeof(import_stages) / sizeof(import_stages[0]); ++i)
+	{
+		if (remaining & import_stages[i].first)
+		{
+			begin = std::chrono::steady_clock::now();
+			ret = importer.ApplyPostProcessing(import_stages[i].first);
+			std::cout << "  " << import_stages[i].second << ": " << elapsed_ms(begin) << " ms" << std::endl;
+			remaining &= ~import_stages[i].first;
+		}
+	}
+
+	if (ret != nullptr && remaining != 0)
+	{
+		begin = std::chrono::steady_clock::now();
+		ret = importer.ApplyPostProcessing(remaining);
+		std::cout << "  other steps: " << elapsed_ms(begin) << " ms" << std::endl;
+	}
+
+	if (ret == nullptr)
+	{
+		std::cout << "could not import " << path << ": " << importer.GetErrorString() << std::endl;
+	}
+
+	return ret;
+}
+
+// prepare_assimp_scene, timed if options ask for it
+model* convert_scene(const aiScene* scene, const import_options& options, worker_pool* pool, gl_task_list& gl_tasks)
+{
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	model* ret = prepare_assimp_scene(scene, options.vertex_attributes, pool, gl_tasks);
+
+	if (options.time_stages)
+	{
+		std::cout << "  convert: " << elapsed_ms(begin) << " ms" << std::endl;
+	}
+
+	return ret;
+}
+
+// imports path with Assimp and writes the cooked result to out_path
+bool cook_model_file(const char* path, const char* out_path, const import_options& options = import_options())
+{
+	Assimp::Importer importer;
+	const aiScene* scene = import_scene(importer, path, options);
+
+	if (scene == nullptr)
+	{
+		return false;
+	}
+
+	cook_options cooking;
+	cooking.vertex_attributes = options.vertex_attributes;
+
+	if (!write_cooked_file(out_path, cook_scene(scene, cooking)))
+	{
+		std::cout << "could not write " << out_path << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool ends_with(const std::string& str, const std::string& suffix)
+{
+	return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// keeps a cooked copy of every imported file in a directory, named after a
+// hash of the file contents and the import options. a valid copy is loaded
+// instead of importing the file again, the least recently used copies are
+// deleted once the directory grows beyond size_limit bytes.
+class import_cache
+{
+public:
+	import_cache(const std::string& directory, uint64_t size_limit)
+		: directory(directory), size_limit(size_limit)
+	{
+		mkdir(directory.c_str(), 0755);
+	}
+
+	import_cache(const import_cache& ) = delete;
+	import_cache& operator=(const import_cache& ) = delete;
+
+	// like prepare_assimp_scene, GL work is left to gl_tasks
+	model* load(const std::string& path, const import_options& options, worker_pool* pool, gl_task_list& gl_tasks)
+	{
+		uint64_t hash;
+
+		if (!hash_file(path.c_str(), hash))
+		{
+			std::cout << "could not read " << path << std::endl;
+			return nullptr;
+		}
+
+		hash = hash_bytes(&options.flags, sizeof(options.flags), hash);
+		hash = hash_bytes(&options.vertex_attributes, sizeof(options.vertex_attributes), hash);
+		hash = hash_bytes(&cooked_model_version, sizeof(cooked_model_version), hash);
+
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.cooked", static_cast<unsigned long long>(hash));
+		std::string cached_path = directory + "/" + name;
+
+		cooked_header header;
+
+		if (read_cooked_header(cached_path.c_str(), header) && header.source_hash == hash)
+		{
+			if (model* ret = prepare_cooked_model(cached_path.c_str(), gl_tasks))
+			{
+				// the modification time doubles as the last use for eviction
+				utimensat(AT_FDCWD, cached_path.c_str(), nullptr, 0);
+				++hit_count;
+				return ret;
+			}
+		}
+
+		++miss_count;
+
+		Assimp::Importer importer;
+		const aiScene* scene = import_scene(importer, path, options);
+
+		if (scene == nullptr)
+		{
+			return nullptr;
+		}
+
+		cook_options cooking;
+		cooking.vertex_attributes = options.vertex_attributes;
+		cooking.source_hash = hash;
+
+		// written under a temporary name, so a crash never leaves a truncated
+		// file that looks valid
+		std::string temp_path = cached_path + ".tmp";
+
+		if (write_cooked_file(temp_path.c_str(), cook_scene(scene, cooking)) &&
+			rename(temp_path.c_str(), cached_path.c_str()) == 0)
+		{
+			evict(cached_path);
+
+			// built from the file just written like on a hit, so the meshes
+			// are not optimized a second time
+			if (model* ret = prepare_cooked_model(cached_path.c_str(), gl_tasks))
+			{
+				return ret;
+			}
+		}
+		else
+		{
+			unlink(temp_path.c_str());
+		}
+
+		return convert_scene(scene, options, pool, gl_tasks);
+	}
+
+	int hits() const
+	{
+		return hit_count;
+	}
+
+	int misses() const
+	{
+		return miss_count;
+	}
+
+	// bytes currently used by cached files
+	uint64_t size() const
+	{
+		uint64_t ret = 0;
+		std::vector<entry> entries = list_entries();
+
+		for (std::vector<entry>::const_iterator iter = entries.begin(); iter != entries.end(); ++iter)
+		{
+			ret += iter->size;
+		}
+
+		return ret;
+	}
+
+	uint64_t limit() const
+	{
+		return size_limit;
+	}
+
+private:
+	struct entry
+	{
+		std::string path;
+		uint64_t size;
+		time_t last_used;
+	};
+
+	std::vector<entry> list_entries() const
+	{
+		std::vector<entry> ret;
+		DIR* dir = opendir(directory.c_str());
+
+		if (dir == nullptr)
+		{
+			return ret;
+		}
+
+		while (dirent* d = readdir(dir))
+		{
+			std::string path = directory + "/" + d->d_name;
+			struct stat st;
+
+			if (ends_with(path, ".cooked") && stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+			{
+				ret.push_back(entry{path, static_cast<uint64_t>(st.st_size), st.st_mtime});
+			}
+		}
+
+		closedir(dir);
+		return ret;
+	}
+
+	// deletes the least recently used files until the cache fits into the
+	// limit again, keep is never deleted
+	void evict(const std::string& keep)
+	{
+		std::vector<entry> entries = list_entries();
+		uint64_t total = 0;
+
+		for (std::vector<entry>::const_iterator iter = entries.begin(); iter != entries.end(); ++iter)
+		{
+			total += iter->size;
+		}
+
+		std::sort(entries.begin(), entries.end(), [](const entry& a, const entry& b)
+		{
+			return a.last_used < b.last_used;
+		});
+
+		for (std::vector<entry>::const_iterator iter = entries.begin(); iter != entries.end() && total > size_limit; ++iter)
+		{
+			if (iter->path != keep && unlink(iter->path.c_str()) == 0)
+			{
+				total -= iter->size;
+			}
+		}
+	}
+
+	std::string directory;
+	uint64_t size_limit;
+	int hit_count = 0;
+	int miss_count = 0;
+};
+
+// builds a cooked model or imports anything else with Assimp, through cache
+// if there is one. GL work is left to gl_tasks, so this runs on any thread.
+model* prepare_model(const std::string& path, const import_options& options, import_cache* cache,
+					 worker_pool* pool, gl_task_list& gl_tasks)
+{
+	model* ret = nullptr;
+
+	if (ends_with(path, ".cooked"))
+	{
+		ret = prepare_cooked_model(path.c_str(), gl_tasks);
+	}
+	else if (cache != nullptr)
+	{
+		ret = cache->load(path, options, pool, gl_tasks);
+	}
+	else
+	{
+		Assimp::Importer importer;
+		const aiScene* scene = import_scene(importer, path, options);
+
+		if (scene == nullptr)
+		{
+			return nullptr;
+		}
+
+		ret = convert_scene(scene, options, pool, gl_tasks);
+	}
+
+	if (ret != nullptr && options.shared_buffers)
+	{
+		// the shared buffers have to exist before the meshes fill them
+		gl_tasks.insert(gl_tasks.begin(), std::bind(&geometry_pool::create_buffers, ret->share_buffers()));
+	}
+
+	return ret;
+}
+
+model* load_model(const std::string& path, const import_options& options = import_options(),
+				  import_cache* cache = nullptr, worker_pool* pool = nullptr)
+{
+	gl_task_list gl_tasks;
+	model* ret = prepare_model(path, options, cache, pool, gl_tasks);
+	run_gl_tasks(gl_tasks);
+	return ret;
+}
+
+// GL work handed over by other threads, drained on the GL thread
+class gl_upload_queue
+{
+public:
+	gl_upload_queue()
+	{
+
+	}
+
+	gl_upload_queue(const gl_upload_queue& ) = delete;
+	gl_upload_queue& operator=(const gl_upload_queue& ) = delete;
+
+	void push(gl_task_list&& new_tasks)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.insert(tasks.end(), std::make_move_iterator(new_tasks.begin()), std::make_move_iterator(new_tasks.end()));
+		new_tasks.clear();
+	}
+
+	// runs queued tasks in order until budget_ms are used up. at least one
+	// task runs per call, so loading makes progress at any frame rate.
+	// returns the number of tasks that ran.
+	int drain(double budget_ms)
+	{
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		int ret = 0;
+
+		for (;;)
+		{
+			std::function<void()> task;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				if (tasks.empty())
+				{
+					break;
+				}
+
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+
+			task();
+			++ret;
+
+			if (elapsed_ms(begin) >= budget_ms)
+			{
+				break;
+			}
+		}
+
+		return ret;
+	}
+
+	size_t pending() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return tasks.size();
+	}
+
+private:
+	mutable std::mutex mutex;
+	std::deque<std::function<void()>> tasks;
+};
+
+// loads models on a background thread. reading, importing and converting
+// happen there (and on pool), the GL work goes to uploads and the future
+// becomes ready once the GL thread has drained all of it. failed loads yield
+// nullptr. cache is only used by the loader thread, cache and pool have to
+// outlive the loader.
+class model_loader
+{
+public:
+	model_loader(gl_upload_queue& uploads, const import_options& options, import_cache* cache, worker_pool* pool)
+		: uploads(uploads), options(options), cache(cache), pool(pool), thread(&model_loader::work, this)
+	{
+
+	}
+
+	model_loader(const model_loader& ) = delete;
+	model_loader& operator=(const model_loader& ) = delete;
+	model_loader(model_loader&& ) = delete;
+	model_loader& operator=(model_loader&& ) = delete;
+
+	// requests that did not start yet are dropped and yield nullptr, GL work
+	// already queued stays in uploads
+	~model_loader()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+
+		request_available.notify_all();
+		thread.join();
+
+		for (std::deque<request>::iterator iter = requests.begin(); iter != requests.end(); ++iter)
+		{
+			iter->result.set_value(nullptr);
+		}
+	}
+
+	std::future<model*> load_async(const std::string& path)
+	{
+		request r;
+		r.path = path;
+		std::future<model*> ret = r.result.get_future();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			requests.push_back(std::move(r));
+		}
+
+		request_available.notify_one();
+		return ret;
+	}
+
+private:
+	struct request
+	{
+		std::string path;
+		std::promise<model*> result;
+	};
+
+	void work()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		for (;;)
+		{
+			request_available.wait(lock, [&]() { return stopping || !requests.empty(); });
+
+			if (stopping)
+			{
+				return;
+			}
+
+			request r = std::move(requests.front());
+			requests.pop_front();
+			lock.unlock();
+
+			gl_task_list gl_tasks;
+			model* ret = prepare_model(r.path, options, cache, pool, gl_tasks);
+
+			if (ret == nullptr)
+			{
+				r.result.set_value(nullptr);
+			}
+			else
+			{
+				// std::function needs copyable targets, the promise is not
+				std::shared_ptr<std::promise<model*>> result = std::make_shared<std::promise<model*>>(std::move(r.result));
+
+				gl_tasks.push_back([result, ret]()
+				{
+					result->set_value(ret);
+				});
+
+				uploads.push(std::move(gl_tasks));
+			}
+
+			lock.lock();
+		}
+	}
+
+	gl_upload_queue& uploads;
+	import_options options;
+	import_cache* cache;
+	worker_pool* pool;
+
+	std::mutex mutex;
+	std::condition_variable request_available;
+	std::deque<request> requests;
+	bool stopping = false;
+
+	// last, so everything above is initialized when it starts
+	std::thread thread;
+};
+
+std::pair<std::vector<vertex>, std::vector<GLushort>> create_circle_mesh_data(int resolution)
+{
+	std::vector<GLushort> indexData(3*resolution);
+	std::vector<vertex> vertexData(resolution + 1);
+
+	vertexData.front() = { vector3(1.0f, 0.0f, 0.0f), vector3(0.0f, 0.0f, -5.0f) };
+
+	float angleStep = (2*M_PI) / (resolution);
+
+	for (int i = 0; i < resolution; ++i)
+	{
+		float x_coord = cos(i*angleStep);
+		float y_coord = sin(i*angleStep);
+		vertexData[i+1].pos =  vector3(x_coord, y_coord, -5.0f);
+		vertexData[i+1].color = vector3(1.0f, 0.0f, 0.0f);
+	}
+
+	for (int i = 0; i < resolution - 1; ++i)
+	{
+		int pos = i * 3;
+		indexData[pos] = 0;
+		indexData[pos + 1] = i + 1;
+		indexData[pos + 2] = i + 2;
+	}
+
+	indexData[(resolution - 1) * 3] = 0;
+	indexData[(resolution - 1) * 3 + 1] = resolution;
+	indexData[(resolution - 1) * 3 + 2] = 1;
+
+	return std::make_pair(vertexData, indexData);
+}
+
+const float horizontal_view_angle = M_PI * 0.5f;
+
+// the projection resize() sets up
+matrix4 projection_matrix(int width, int height)
+{
+	float aspect_ratio = float(height) / float(width);
+	float near_plane = 1.0f;
+	float far_plane = 1000.0f;
+	float right = near_plane * tanf(horizontal_view_angle * 0.5f);
+
+	return frustum_projection(-right, right, -right*aspect_ratio, right*aspect_ratio, near_plane, far_plane);
+}
+
+// returns the size in pixels of one unit at distance 1, for render_view
+float resize(int width, int height)
+{
+	matrix4 projection = projection_matrix(width, height);
+	float m[16];
+
+	for (int i = 0; i < 16; ++i)
+	{
+		m[i] = projection(i % 4, i / 4);
+	}
+
+	glViewport(0, 0, width, height);
+	glMatrixMode(GL_PROJECTION);
+	glLoadMatrixf(m);
+	glMatrixMode(GL_MODELVIEW);
+
+	return 0.5f * width / tanf(horizontal_view_angle * 0.5f);
+}
+
+// builds a tree of the given depth where every inner node has branching
+// children, all nodes get random but plausible transform data and a unique
+// name derived from name, which are also appended to names
+model_node* create_benchmark_hierarchy(int depth, int branching, std::mt19937& rng, arena& storage,
+									   const std::string& name, std::vector<std::string>& names)
+{
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+	model_node* ret = storage.create<model_node>();
+	ret->name = name;
+	names.push_back(name);
+	ret->original_transform = translation(vector3(dist(rng), dist(rng), dist(rng)));
+
+	float angle = dist(rng) * float(M_PI);
+	ret->set_transform_data(vector3(dist(rng), dist(rng), dist(rng)),
+							quaternion(std::cos(angle * 0.5f), 0.0f, std::sin(angle * 0.5f), 0.0f),
+							vector3(1.0f + 0.1f * dist(rng), 1.0f + 0.1f * dist(rng), 1.0f + 0.1f * dist(rng)));
+
+	if (depth > 1)
+	{
+		model_node** curr_child = &ret->first_child;
+
+		for (int i = 0; i < branching; ++i)
+		{
+			*curr_child = create_benchmark_hierarchy(depth - 1, branching, rng, storage, name + "_" + std::to_string(i), names);
+			curr_child = &((*curr_child)->next_sibling);
+		}
+	}
+
+	return ret;
+}
+
+// runs f iterations times and returns the average duration in milliseconds,
+// the best of a few rounds is taken to filter out scheduling noise
+template <typename F>
+double measure_ms(int iterations, F f)
+{
+	double best = 0.0;
+
+	for (int round = 0; round < 5; ++round)
+	{
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < iterations; ++i)
+		{
+			f();
+		}
+
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		double ms = std::chrono::duration<double, std::milli>(end - begin).count() / iterations;
+
+		if (round == 0 || ms < best)
+		{
+			best = ms;
+		}
+	}
+
+	return best;
+}
+
+void benchmark_transform_chain()
+{
+	const int node_cnt = 4096;
+	const int iterations = 50;
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+	std::vector<matrix4> parents(node_cnt);
+	std::vector<matrix4> originals(node_cnt);
+	std::vector<vector3> positions(node_cnt);
+	std::vector<quaternion> rotations(node_cnt);
+	std::vector<vector3> scales(node_cnt);
+
+	for (int i = 0; i < node_cnt; ++i)
+	{
+		parents[i] = translation(vector3(dist(rng), dist(rng), dist(rng))) * rotation(quaternion(0.8f, 0.6f, 0.0f, 0.0f));
+		originals[i] = translation(vector3(dist(rng), dist(rng), dist(rng)));
+		positions[i] = vector3(dist(rng), dist(rng), dist(rng));
+		float angle = dist(rng) * float(M_PI);
+		rotations[i] = quaternion(std::cos(angle * 0.5f), std::sin(angle * 0.5f), 0.0f, 0.0f);
+		scales[i] = vector3(1.0f + dist(rng), 1.0f + dist(rng), 1.0f + dist(rng));
+	}
+
+	std::vector<matrix4> full(node_cnt);
+	std::vector<matrix4> fused(node_cnt);
+
+	double full_ms = measure_ms(iterations, [&]()
+	{
+		for (int i = 0; i < node_cnt; ++i)
+		{
+			full[i] = parents[i] * originals[i] * matrix4(translation(positions[i])) *
+					  matrix4(rotation(rotations[i])) * matrix4(non_uniform_scale(scales[i]));
+		}
+	});
+
+	double fused_ms = measure_ms(iterations, [&]()
+	{
+		for (int i = 0; i < node_cnt; ++i)
+		{
+			fused[i] = parents[i] * originals[i] * translation(positions[i]) *
+					   rotation(rotations[i]) * non_uniform_scale(scales[i]);
+		}
+	});
+
+	float max_error = 0.0f;
+
+	for (int i = 0; i < node_cnt; ++i)
+	{
+		for (int j = 0; j < 16; ++j)
+		{
+			max_error = std::max(max_error, std::fabs(full[i].elements[j] - fused[i].elements[j]));
+		}
+	}
+
+	std::cout << "transform chain, " << node_cnt << " nodes" << std::endl;
+	std::cout << "  full 4x4 products: " << full_ms << " ms" << std::endl;
+	std::cout << "  matrix chain:      " << fused_ms << " ms" << std::endl;
+	std::cout << "  max difference:    " << max_error << std::endl;
+
+	// the same chain as it is used per frame by model_node::update_transform
+	std::mt19937 hierarchy_rng(42);
+	std::vector<std::string> names;
+	arena storage;
+	model_node* root = create_benchmark_hierarchy(6, 4, hierarchy_rng, storage, "node", names);
+
+	double update_ms = measure_ms(iterations, [&]()
+	{
+		root->update_transform(identity());
+	});
+
+	std::cout << "  update_transform, depth 6 branching 4 hierarchy: " << update_ms << " ms" << std::endl;
+}
+
+// a skeleton sized model with a looping "walk" animation on every node
+model* create_benchmark_model(std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+	std::vector<std::string> names;
+	arena* storage = new arena(64 * 1024);
+	model_node* root = create_benchmark_hierarchy(4, 3, rng, *storage, "node", names);
+
+	std::vector<animation_set> anim_sets(1);
+	anim_sets.back().first = "walk";
+
+	for (std::vector<std::string>::iterator iter = names.begin(); iter != names.end(); ++iter)
+	{
+		animation anim;
+		anim.node_ref = *iter;
+
+		for (int i = 0; i <= 4; ++i)
+		{
+			float angle = dist(rng) * float(M_PI);
+			anim.pos_keys.push_back(std::make_pair(i * 1200.0, vector3(dist(rng), dist(rng), dist(rng))));
+			anim.rot_keys.push_back(std::make_pair(i * 1200.0, quaternion(std::cos(angle * 0.5f), std::sin(angle * 0.5f), 0.0f, 0.0f)));
+		}
+
+		anim.scale_keys.push_back(std::make_pair(0.0, vector3(1.0f, 1.0f, 1.0f)));
+		anim_sets.back().second.push_back(anim);
+	}
+
+	model* ret = new model(storage, root, identity(), anim_sets, 4800.0);
+	ret->play_anim("walk");
+	return ret;
+}
+
+void benchmark_scene_update()
+{
+	const int model_cnt = 2000;
+	const int frames = 10;
+	const int max_threads = std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
+
+	std::cout << "scene update, " << model_cnt << " animated models with 40 nodes, "
+			  << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+
+	std::vector<matrix4> reference;
+	double single_thread_ms = 0.0;
+
+	for (int thread_cnt = 1; thread_cnt <= max_threads; thread_cnt *= 2)
+	{
+		std::mt19937 rng(7);
+		std::vector<model*> models;
+		std::vector<std::string> names;
+		arena name_storage;
+		create_benchmark_hierarchy(4, 3, rng, name_storage, "node", names);
+		rng.seed(7);
+
+		for (int i = 0; i < model_cnt; ++i)
+		{
+			models.push_back(create_benchmark_model(rng));
+		}
+
+		worker_pool pool(thread_cnt);
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
+		for (int i = 0; i < frames; ++i)
+		{
+			update_models(models, 1.0f / 60.0f, pool);
+		}
+
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+		double ms = std::chrono::duration<double, std::milli>(end - begin).count() / frames;
+
+		std::vector<matrix4> transforms;
+
+		for (std::vector<model*>::iterator iter = models.begin(); iter != models.end(); ++iter)
+		{
+			for (std::vector<std::string>::iterator iter2 = names.begin(); iter2 != names.end(); ++iter2)
+			{
+				transforms.push_back((*iter)->find_node(*iter2)->get_transform());
+			}
+
+			delete *iter;
+		}
+
+		if (thread_cnt == 1)
+		{
+			reference = transforms;
+			single_thread_ms = ms;
+		}
+
+		std::cout << "  " << thread_cnt << " threads: " << ms << " ms per frame, speedup " << single_thread_ms / ms
+				  << (transforms == reference ? ", identical to 1 thread" : ", DIFFERS from 1 thread") << std::endl;
+	}
+
+	// a single large model, split up by subtree instead of by model
+	std::vector<std::string> names;
+	std::mt19937 rng(7);
+	arena storage;
+	model_node* root = create_benchmark_hierarchy(7, 4, rng, storage, "node", names);
+	root->update_subtree_size();
+
+	std::cout << "hierarchy update, one model with " << names.size() << " nodes" << std::endl;
+
+	for (int thread_cnt = 1; thread_cnt <= max_threads; thread_cnt *= 2)
+	{
+		worker_pool pool(thread_cnt);
+
+		double ms = measure_ms(20, [&]()
+		{
+			root->update_transform(identity(), &pool);
+		});
+
+		std::vector<matrix4> transforms;
+
+		for (std::vector<std::string>::iterator iter = names.begin(); iter != names.end(); ++iter)
+		{
+			transforms.push_back(root->find(*iter)->get_transform());
+		}
+
+		if (thread_cnt == 1)
+		{
+			reference = transforms;
+			single_thread_ms = ms;
+		}
+
+		std::cout << "  " << thread_cnt << " threads: " << ms << " ms, speedup " << single_thread_ms / ms
+				  << (transforms == reference ? ", identical to 1 thread" : ", DIFFERS from 1 thread") << std::endl;
+	}
+}
+
+// benchmarks that touch GL need a context, but no visible window
+struct hidden_gl_context
+{
+	hidden_gl_context()
+	{
+		SDL_Init(SDL_INIT_VIDEO);
+		window = SDL_CreateWindow("benchmark", 0, 0, 64, 64, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+		context = SDL_GL_CreateContext(window);
+		glewInit();
+	}
 
-	matrix4 transform = identity();
-	matrix4 original_transform = identity();
+	~hidden_gl_context()
+	{
+		SDL_GL_DeleteContext(context);
+		SDL_DestroyWindow(window);
+		SDL_Quit();
+	}
 
-	std::string name;
+	hidden_gl_context(const hidden_gl_context&) = delete;
+	hidden_gl_context& operator=(const hidden_gl_context&) = delete;
 
-	vector3 pos;
-	quaternion rot;
-	vector3 scale;
+	SDL_Window* window;
+	SDL_GLContext context;
 };
 
-void mesh::update(model_node* root, const matrix4& global_inverse)
+void benchmark_model_load()
 {
-	uint8_t* transformed_vertex_data = new uint8_t[vertex_cnt * vertex_size];
+	const char* path = "trinity.x";
+	std::string cooked_path = std::string(path) + ".cooked";
 
-	std::copy(vertex_data, vertex_data + vertex_cnt * vertex_size, transformed_vertex_data);
-
-	for (int i = 8; i < vertex_cnt * vertex_size; i += vertex_size)
+	if (!cook_model_file(path, cooked_path.c_str()))
 	{
-		vector3* tmp = reinterpret_cast<vector3*>(transformed_vertex_data + i);
-		tmp->x = 0.0f;
-		tmp->y = 0.0f;
-		tmp->y = 0.0f;
+		return;
 	}
 
-	for (std::vector<bone>::iterator iter = bones.begin(); iter != bones.end(); ++iter)
+	hidden_gl_context gl;
+	const int iterations = 3;
+
+	double assimp_ms = measure_ms(iterations, [&]()
 	{
-		model_node* bone_node = root->find(iter->node_ref);
+		Assimp::Importer importer;
+		delete load_from_assimp_scene(importer.ReadFile(path, default_import_flags));
+	});
 
-		matrix4 transform = global_inverse * bone_node->get_transform() * iter->transform;
-		//matrix4 transform = bone_node->get_transform();
-		//matrix4 transform = identity();
+	double cooked_ms = measure_ms(iterations, [&]()
+	{
+		delete load_cooked_model(cooked_path.c_str());
+	});
 
-		for (std::vector<std::pair<int, float>>::iterator iter2 = iter->vertices.begin();
-			 iter2 != iter->vertices.end(); ++iter2)
-		{
-			vector3* curr_vertex = reinterpret_cast<vector3*>(vertex_data + 8 + iter2->first * vertex_size);
-			vector3* transformed_vertex = reinterpret_cast<vector3*>(transformed_vertex_data + 8 + iter2->first * vertex_size);
+	import_cache cache("benchmark_import_cache", 64 * 1024 * 1024);
 
-			vector3 tmp = transform_vector(transform, *curr_vertex);
+	double cache_ms = measure_ms(iterations, [&]()
+	{
+		delete load_model(path, import_options(), &cache);
+	});
 
-			transformed_vertex->x += iter2->second * tmp.x;
-			transformed_vertex->y += iter2->second * tmp.y;
-			transformed_vertex->z += iter2->second * tmp.z;
-		}
-	}
+	std::cout << "model load, " << path << std::endl;
+	std::cout << "  assimp import: " << assimp_ms << " ms" << std::endl;
+	std::cout << "  cooked mmap:   " << cooked_ms << " ms, speedup " << assimp_ms / cooked_ms << std::endl;
+	std::cout << "  import cache:  " << cache_ms << " ms, " << cache.hits() << " hit(s), " << cache.misses() << " miss(es)" << std::endl;
 
-	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-	glBufferData(GL_ARRAY_BUFFER, vertex_cnt * vertex_size, transformed_vertex_data, GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	// only the conversion, the import itself is single threaded in Assimp
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, default_import_flags);
+	int max_threads = std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
+	double single_thread_ms = 0.0;
 
-	delete[] transformed_vertex_data;
-}
+	std::cout << "assimp scene conversion, " << scene->mNumMeshes << " meshes, " << scene->mNumMaterials << " materials" << std::endl;
 
-struct animation
-{
-	typedef std::vector<std::pair<double, vector3>> pos_key_list;
-	typedef std::vector<std::pair<double, quaternion>> rot_key_list;
-	typedef std::vector<std::pair<double, vector3>> scale_key_list;
+	for (int thread_cnt = 1; thread_cnt <= max_threads; thread_cnt *= 2)
+	{
+		worker_pool pool(thread_cnt);
 
-	std::string node_ref;
-	// .x file format and wme both actually use a 32 bit integer for time
-	pos_key_list pos_keys;
-	rot_key_list rot_keys;
-	scale_key_list scale_keys;
-	double local_time = 0.0f;
+		double ms = measure_ms(iterations, [&]()
+		{
+			delete load_from_assimp_scene(scene, &pool);
+		});
 
-	void update(double local_time, model_node* node)
-	{
-		vector3 pos = update_positions(local_time);
-		quaternion rot = update_rotations(local_time);
-		vector3 scale = update_scalings(local_time);
+		if (thread_cnt == 1)
+		{
+			single_thread_ms = ms;
+		}
 
-		node->set_transform_data(pos, rot, scale);
+		std::cout << "  " << thread_cnt << " threads: " << ms << " ms, speedup " << single_thread_ms / ms << std::endl;
 	}
+}
 
-	// this is three times the same algorithm, do something generic here
-	vector3 update_positions(double local_time)
+// import time and resulting geometry for every import profile, with one
+// stage by stage breakdown each
+void benchmark_import_profiles()
+{
+	const char* path = "trinity.x";
+	hidden_gl_context gl;
+
+	for (int i = 0; i < import_profile_count; ++i)
 	{
-		if (pos_keys.size () < 2)
+		import_options options;
+		options.flags = import_profiles[i].flags;
+
+		double ms = measure_ms(3, [&]()
 		{
-			return (vector3(0.0f, 0.0f, 0.0f));
-		}
+			Assimp::Importer importer;
+			const aiScene* scene = import_scene(importer, path, options);
+			gl_task_list gl_tasks;
+			model* result = scene != nullptr ? convert_scene(scene, options, nullptr, gl_tasks) : nullptr;
+			run_gl_tasks(gl_tasks);
+			delete result;
+		});
 
-		pos_key_list::iterator key1 = pos_keys.end();
-		pos_key_list::iterator key2 = pos_keys.end();
+		std::cout << "profile " << import_profiles[i].name << ": " << ms << " ms" << std::endl;
 
-		for (pos_key_list::iterator iter = pos_keys.begin(); iter < pos_keys.end(); ++iter)
+		options.time_stages = true;
+		Assimp::Importer importer;
+		const aiScene* scene = import_scene(importer, path, options);
+
+		if (scene == nullptr)
 		{
-			if (iter->first / 1000.0f > local_time)
-			{
-				// wme does something different here, not sure why
-				key1 = iter;
-				key2 = iter + 1;
-				break;
-			}
+			continue;
 		}
 
-		if (key1 == pos_keys.end() || key2 == pos_keys.end())
+		gl_task_list gl_tasks;
+		model* result = convert_scene(scene, options, nullptr, gl_tasks);
+		run_gl_tasks(gl_tasks);
+		delete result;
+
+		unsigned vertices = 0;
+		unsigned triangles = 0;
+		size_t vertex_bytes = 0;
+		size_t index_bytes = 0;
+
+		for (unsigned j = 0; j < scene->mNumMeshes; ++j)
 		{
-			return pos_keys.back().second;
+			const aiMesh* m = scene->mMeshes[j];
+			vertices += m->mNumVertices;
+			triangles += m->mNumFaces;
+			vertex_bytes += m->mNumVertices * choose_vertex_layout(scene, m, options.vertex_attributes).size;
+			index_bytes += m->mNumFaces * 3 * index_size_for(m->mNumVertices);
 		}
 
-		float lerp = (key1->first - local_time) / (key2->first - key1->first);
-		return linear_interpolation(key1->second, key2->second, lerp);
+		std::cout << "  result: " << scene->mNumMeshes << " meshes, " << vertices << " vertices, " << triangles << " triangles, "
+				  << vertex_bytes << " vertex bytes, " << index_bytes << " index bytes" << std::endl;
 	}
+}
 
-	quaternion update_rotations(double local_time)
+// size, decoding error and skinning plus upload time of the float and the
+// compressed vertex formats
+void benchmark_vertex_formats()
+{
+	const char* path = "trinity.x";
+	hidden_gl_context gl;
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, default_import_flags);
+
+	if (scene == nullptr)
 	{
-		if (rot_keys.size() < 2)
-		{
-			return quaternion(0.0f, 0.0f, 0.0f, 1.0f);
-		}
+		std::cout << "could not import " << path << ": " << importer.GetErrorString() << std::endl;
+		return;
+	}
 
-		rot_key_list::iterator key1 = rot_keys.end();
-		rot_key_list::iterator key2 = rot_keys.end();
+	const std::pair<unsigned, const char*> formats[] =
+	{
+		std::make_pair(vertex_uv, "float"),
+		std::make_pair(vertex_uv | vertex_compressed, "compressed"),
+		std::make_pair(vertex_uv | vertex_normal, "float with normals"),
+		std::make_pair(vertex_uv | vertex_normal | vertex_compressed, "compressed with normals")
+	};
 
-		for (rot_key_list::iterator iter = rot_keys.begin(); iter < rot_keys.end(); ++iter)
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); ++i)
+	{
+		unsigned attributes = formats[i].first;
+		size_t vertex_bytes = 0;
+
+		for (unsigned j = 0; j < scene->mNumMeshes; ++j)
 		{
-			if (iter->first / 1000.0f > local_time)
-			{
-				// wme does something different here, not sure why
-				key1 = iter;
-				key2 = iter + 1;
-				break;
-			}
+			vertex_bytes += scene->mMeshes[j]->mNumVertices * choose_vertex_layout(scene, scene->mMeshes[j], attributes).size;
 		}
 
-		if (key1 == rot_keys.end() || key2 == rot_keys.end())
+		vertex_error error = measure_vertex_error(scene, attributes);
+		model* m = load_from_assimp_scene(scene, nullptr, attributes);
+		m->play_anim("walk");
+
+		double ms = measure_ms(20, [&]()
 		{
-			return rot_keys.back().second;
-		}
+			m->animate(1.0f / 60.0f);
+			m->upload();
+		});
 
-		float lerp = (key1->first - local_time) / (key2->first - key1->first);
+		delete m;
 
-		quaternion q1 (key1->second.w, -key1->second.x, -key1->second.y, -key1->second.z);
-		quaternion q2 (key2->second.w, -key2->second.x, -key2->second.y, -key2->second.z);
+		std::cout << formats[i].second << ": " << vertex_bytes << " vertex bytes, skinning and upload " << ms << " ms" << std::endl;
+		std::cout << "  max error: position " << error.position << ", uv " << error.uv << ", normal " << error.normal << " degrees" << std::endl;
+	}
+}
 
-		return spherical_linear_interpolation(q1, q2, lerp);
+// post-transform cache efficiency of every mesh as Assimp returns it without
+// ImproveCacheLocality and after the reordering done on load
+void benchmark_vertex_cache()
+{
+	const char* path = "trinity.x";
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, find_import_profile("fast-preview")->flags);
+
+	if (scene == nullptr)
+	{
+		std::cout << "could not import " << path << ": " << importer.GetErrorString() << std::endl;
+		return;
 	}
 
-	vector3 update_scalings(double local_time)
+	for (unsigned i = 0; i < scene->mNumMeshes; ++i)
 	{
-		if (scale_keys.size() < 2)
+		const aiMesh* m = scene->mMeshes[i];
+		std::vector<uint32_t> remap;
+		std::vector<mesh_lod> lods;
+		std::vector<uint32_t> optimized;
+
+		double ms = measure_ms(3, [&]()
 		{
-			return vector3(1.0f, 1.0, 1.0f);
-		}
+			optimized = optimize_assimp_mesh(m, remap, lods);
+		});
 
-		scale_key_list::iterator key1;
-		scale_key_list::iterator key2;
+		optimized.resize(lods[0].index_count);
+		std::cout << "mesh " << i << ": " << m->mNumFaces << " triangles, ACMR "
+				  << average_cache_miss_ratio(read_assimp_triangles(m)) << " -> " << average_cache_miss_ratio(optimized)
+				  << ", optimized with levels of detail in " << ms << " ms" << std::endl;
+	}
+}
 
-		for (scale_key_list::iterator iter = scale_keys.begin(); iter < scale_keys.end(); ++iter)
-		{
-			if (iter->first > local_time)
-			{
-				// wme does something different here, not sure why
-				key1 = iter;
-				key2 = iter + 1;
-				break;
-			}
-		}
+// the levels of detail of every mesh and which one is drawn at a few
+// distances in an 800 pixel wide window
+void benchmark_lods()
+{
+	const char* path = "trinity.x";
+	hidden_gl_context gl;
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, default_import_flags);
 
-		float lerp = (key1->first - local_time) / (key2->first - key1->first);
-		return linear_interpolation(key1->second, key2->second, lerp);
+	if (scene == nullptr)
+	{
+		std::cout << "could not import " << path << ": " << importer.GetErrorString() << std::endl;
+		return;
 	}
 
-	double total_time()
+	render_view view;
+	view.pixels_per_unit = resize(800, 600);
+	// far away levels would be behind the far plane
+	view.culling = false;
+	model* m = load_from_assimp_scene(scene);
+	const float distances[] = {10.0f, 100.0f, 1000.0f, 10000.0f};
+
+	for (size_t i = 0; i < sizeof(distances) / sizeof(distances[0]); ++i)
 	{
-		// wme does the same here, appearently the total time
-		// is not contained in the .x file format
-		double ret = 0.0;
+		glLoadIdentity();
+		glTranslatef(0.0f, 0.0f, -distances[i]);
+		view.reset_stats();
+		m->render(view);
 
-		if (!pos_keys.empty())
-		{
-			ret = std::max(ret, pos_keys.back().first);
-		}
+		std::cout << "distance " << distances[i] << ":";
 
-		if (!rot_keys.empty())
+		for (int j = 0; j < max_lod_count; ++j)
 		{
-			ret = std::max(ret, rot_keys.back().first);
+			std::cout << " " << view.triangles[j];
 		}
 
-		if (!scale_keys.empty())
+		std::cout << " triangles per level" << std::endl;
+	}
+
+	delete m;
+
+	for (unsigned i = 0; i < scene->mNumMeshes; ++i)
+	{
+		std::vector<uint32_t> remap;
+		std::vector<mesh_lod> lods;
+		optimize_assimp_mesh(scene->mMeshes[i], remap, lods);
+		std::cout << "mesh " << i << ":";
+
+		for (std::vector<mesh_lod>::const_iterator iter = lods.begin(); iter != lods.end(); ++iter)
 		{
-			ret = std::max(ret, scale_keys.back().first);
+			std::cout << " " << iter->index_count / 3 << " triangles (error " << iter->error << ")";
 		}
 
-		return ret;
+		std::cout << std::endl;
 	}
-};
-
-typedef std::pair<std::string, std::vector<animation>> animation_set;
+}
 
-class model
+// skinning time per frame without culling, with the model in view like in
+// the playground and with the model behind the camera
+void benchmark_culling()
 {
-public:
-	model(model_node* root, matrix4 global_inverse, const std::vector<animation_set>& anim_sets, double ticks_per_second)
-		: root(root), global_inverse(global_inverse), animation_sets(anim_sets), ticks_per_second(ticks_per_second)
+	const char* path = "trinity.x";
+	hidden_gl_context gl;
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, default_import_flags);
+
+	if (scene == nullptr)
+	{
+		std::cout << "could not import " << path << ": " << importer.GetErrorString() << std::endl;
+		return;
+	}
+
+	matrix4 projection = projection_matrix(800, 600);
+	frustum in_view = extract_frustum(projection * matrix4(translation(vector3(0.0f, -40.0f, -100.0f))));
+	frustum behind = extract_frustum(projection * matrix4(translation(vector3(0.0f, -40.0f, 100.0f))));
+
+	const std::pair<const frustum*, const char*> views[] =
+	{
+		std::make_pair(static_cast<const frustum*>(nullptr), "no culling"),
+		std::make_pair(&in_view, "in view"),
+		std::make_pair(&behind, "behind the camera")
+	};
+
+	model* m = load_from_assimp_scene(scene);
+	m->play_anim("walk");
+
+	for (size_t i = 0; i < sizeof(views) / sizeof(views[0]); ++i)
 	{
+		double ms = measure_ms(20, [&]()
+		{
+			m->update(1.0f / 60.0f, views[i].first);
+		});
 
+		std::cout << views[i].second << ": skinning and upload " << ms << " ms" << std::endl;
 	}
 
-	model(const model& ) = delete;
-	model& operator=(const model& ) = delete;
+	delete m;
+}
 
-	model(model&& other)
+// instances of the model spread over a large volume, moving a bit every
+// frame. the hierarchy is built once and refit, the queries are compared
+// with testing every instance.
+void benchmark_bvh()
+{
+	const char* path = "trinity.x";
+	hidden_gl_context gl;
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, default_import_flags);
+
+	if (scene == nullptr)
 	{
-		root = other.root;
-		other.root = nullptr;
+		std::cout << "could not import " << path << ": " << importer.GetErrorString() << std::endl;
+		return;
 	}
 
-	model& operator=(model&& other)
+	model* m = load_from_assimp_scene(scene);
+	m->play_anim("walk");
+	m->animate(1.0f / 60.0f);
+	bounding_box model_bounds = m->bounds();
+	delete m;
+
+	const int instance_count = 10000;
+	const int ray_count = 1000;
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> position(-2000.0f, 2000.0f);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+	std::vector<vector3> positions(instance_count);
+	std::vector<vector3> velocities(instance_count);
+	std::vector<bounding_box> boxes(instance_count);
+
+	for (int i = 0; i < instance_count; ++i)
 	{
-		root = other.root;
-		other.root = nullptr;
-		return *this;
+		positions[i] = vector3(position(rng), position(rng), position(rng));
+		velocities[i] = vector3(unit(rng), unit(rng), unit(rng));
 	}
 
-	~model()
+	auto place = [&]()
 	{
-		if (root)
+		for (int i = 0; i < instance_count; ++i)
 		{
-			delete root;
+			boxes[i] = bounding_box();
+			boxes[i].add(model_bounds.min + positions[i]);
+			boxes[i].add(model_bounds.max + positions[i]);
 		}
-	}
+	};
 
-	void render()
+	auto move = [&]()
 	{
-		if (root)
+		for (int i = 0; i < instance_count; ++i)
 		{
-			root->render();
+			positions[i] = positions[i] + velocities[i];
 		}
+
+		place();
+	};
+
+	place();
+
+	bvh tree;
+	double build_ms = measure_ms(10, [&]()
+	{
+		tree.build(boxes);
+	});
+
+	// a few hundred frames of movement, then refit
+	for (int i = 0; i < 300; ++i)
+	{
+		move();
 	}
 
-	void update(float delta)
+	double refit_ms = measure_ms(10, [&]()
 	{
-		local_time += delta;
-		//local_time *= (ticks_per_second / 1000.0);
+		tree.refit(boxes);
+	});
 
-		if (local_time > 4800.0 / 1000.0)
-		{
-			local_time = 0.0;
-		}
+	std::cout << instance_count << " instances: build " << build_ms << " ms, " << tree.node_count()
+			  << " nodes, refit " << refit_ms << " ms" << std::endl;
 
-		for (std::vector<animation>::iterator iter = curr_anim->second.begin();
-			 iter != curr_anim->second.end(); ++iter)
-		{
-			model_node* target = find_node(iter->node_ref);
+	frustum view = extract_frustum(projection_matrix(800, 600));
+	std::vector<int> visible;
+	std::vector<int> visible_brute_force;
 
-			if (target != nullptr)
+	double query_ms = measure_ms(20, [&]()
+	{
+		visible.clear();
+		tree.query(view, visible);
+	});
+
+	double brute_force_ms = measure_ms(20, [&]()
+	{
+		visible_brute_force.clear();
+
+		for (int i = 0; i < instance_count; ++i)
+		{
+			if (box_in_frustum(view, boxes[i]) != containment::outside)
 			{
-				iter->update(local_time, target);
+				visible_brute_force.push_back(i);
 			}
 		}
+	});
 
-		root->update_transform(identity());
-		root->update_meshes(root, global_inverse);
+	std::sort(visible.begin(), visible.end());
+	std::cout << "frustum: " << visible.size() << " visible, " << query_ms << " ms, brute force " << brute_force_ms
+			  << " ms" << (visible == visible_brute_force ? "" : ", results differ") << std::endl;
+
+	std::vector<std::pair<vector3, vector3>> rays(ray_count);
+
+	for (int i = 0; i < ray_count; ++i)
+	{
+		vector3 direction(unit(rng), unit(rng), unit(rng));
+		rays[i] = std::make_pair(vector3(position(rng), position(rng), position(rng)), direction * (1.0f / vector_length(direction)));
 	}
 
-	void play_anim(const std::string& name)
+	std::vector<int> hits(ray_count);
+	std::vector<int> hits_brute_force(ray_count);
+
+	double ray_ms = measure_ms(5, [&]()
 	{
-		for (std::vector<animation_set>::iterator iter = animation_sets.begin(); iter < animation_sets.end(); ++iter)
+		for (int i = 0; i < ray_count; ++i)
 		{
-			if (iter->first == name)
+			float distance;
+			hits[i] = tree.raycast(rays[i].first, rays[i].second, distance);
+		}
+	});
+
+	double ray_brute_force_ms = measure_ms(5, [&]()
+	{
+		for (int i = 0; i < ray_count; ++i)
+		{
+			const vector3& direction = rays[i].second;
+			vector3 inverse_direction(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+			float nearest = HUGE_VALF;
+			hits_brute_force[i] = -1;
+
+			for (int j = 0; j < instance_count; ++j)
 			{
-				curr_anim = &(*iter);
+				float distance;
+
+				if (ray_hits_box(rays[i].first, inverse_direction, boxes[j], nearest, distance) && distance < nearest)
+				{
+					nearest = distance;
+					hits_brute_force[i] = j;
+				}
 			}
 		}
+	});
+
+	int hit_count = static_cast<int>(std::count_if(hits.begin(), hits.end(), [](int hit) { return hit >= 0; }));
+	std::cout << ray_count << " rays: " << hit_count << " hit, " << ray_ms << " ms, brute force " << ray_brute_force_ms
+			  << " ms" << (hits == hits_brute_force ? "" : ", results differ") << std::endl;
+}
+
+// a wall drawn as occluder in front of a crowd of model instances, some
+// of them behind it. the instances are tested against the wall and the
+// ones reported as occluded are checked to be really behind it.
+void benchmark_occlusion()
+{
+	const char* path = "trinity.x";
+	hidden_gl_context gl;
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, default_import_flags);
+
+	if (scene == nullptr)
+	{
+		std::cout << "could not import " << path << ": " << importer.GetErrorString() << std::endl;
+		return;
 	}
 
-	model_node* find_node(const std::string& ref)
+	model* m = load_from_assimp_scene(scene);
+	m->play_anim("walk");
+	m->animate(1.0f / 60.0f);
+	bounding_box model_bounds = m->bounds();
+
+	double skinning_ms = measure_ms(20, [&]()
 	{
-		if (root != nullptr)
-		{
-			return root->find(ref);
-		}
+		m->skin();
+	});
 
-		return nullptr;
+	delete m;
+
+	const int instance_count = 10000;
+	const float wall_distance = 100.0f;
+	const float wall_size = 150.0f;
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> sideways(-400.0f, 400.0f);
+	std::uniform_real_distribution<float> distance(10.0f, 900.0f);
+
+	std::vector<bounding_box> boxes(instance_count);
+
+	for (int i = 0; i < instance_count; ++i)
+	{
+		vector3 offset(sideways(rng), sideways(rng) * 0.25f, -distance(rng));
+		boxes[i].add(model_bounds.min + offset);
+		boxes[i].add(model_bounds.max + offset);
 	}
 
-private:
-	model_node* root = nullptr;
-	matrix4 global_inverse;
-	std::vector<animation_set> animation_sets;
-	animation_set* curr_anim;
-	double ticks_per_second = 4800.0; // x. and wme use an 32-bit integer
-	float local_time = 0.0f;
-};
+	const vector3 wall[4] =
+	{
+		vector3(-wall_size, -wall_size, -wall_distance),
+		vector3(wall_size, -wall_size, -wall_distance),
+		vector3(wall_size, wall_size, -wall_distance),
+		vector3(-wall_size, wall_size, -wall_distance)
+	};
 
-texture* load_texture(const char* file)
-{
-	int width = 0;
-	int height = 0;
-	int compression = 0;
+	occlusion_buffer occlusion(200, 150);
+	matrix4 view_projection = projection_matrix(800, 600);
+
+	double rasterize_ms = measure_ms(100, [&]()
+	{
+		occlusion.clear(view_projection);
+		occlusion.rasterize_triangle(wall[0], wall[1], wall[2]);
+		occlusion.rasterize_triangle(wall[0], wall[2], wall[3]);
+	});
 
-	uint8_t* data = stbi_load(file, &width, &height, &compression, STBI_rgb_alpha);
+	std::vector<char> occluded(instance_count);
 
-	if (data == nullptr)
+	double test_ms = measure_ms(20, [&]()
 	{
-		std::cout << stbi_failure_reason() << std::endl;
-		return nullptr;
-	}
+		for (int i = 0; i < instance_count; ++i)
+		{
+			occluded[i] = occlusion.occluded(boxes[i]);
+		}
+	});
 
-	uint8_t* data_fixed = new uint8_t[width * height * 4];
+	int occluded_count = 0;
+	int wrong = 0;
 
-	for (int i = 0; i < width * 4; i += 4)
+	for (int i = 0; i < instance_count; ++i)
 	{
-		for (int j = 0; j < height; ++j)
+		if (occluded[i])
 		{
-			data_fixed[j * width * 4 + i] = data[(height - j - 1) * width * 4 + i];
-			data_fixed[j * width * 4 + i + 1] = data[(height - j - 1) * width * 4 + i + 1];
-			data_fixed[j * width * 4 + i + 2] = data[(height - j - 1) * width * 4 + i + 2];
-			data_fixed[j * width * 4 + i + 3] = data[(height - j - 1) * width * 4 + i + 3];
+			++occluded_count;
+
+			// behind the wall plane and within its silhouette from the eye
+			const bounding_box& b = boxes[i];
+			float scale = wall_distance / -b.max.z;
+			bool behind = b.max.z < -wall_distance && b.min.x * scale >= -wall_size && b.max.x * scale <= wall_size &&
+						  b.min.y * scale >= -wall_size && b.max.y * scale <= wall_size;
+			wrong += behind ? 0 : 1;
 		}
 	}
 
-	texture* tex = new texture(data_fixed, width, height);
-	stbi_image_free(data);
-	delete[] data_fixed;
-	return tex;
+	std::cout << "occluder: " << occlusion.get_width() << "x" << occlusion.get_height() << " pixels, rasterized in "
+			  << rasterize_ms << " ms" << std::endl;
+	std::cout << instance_count << " instances: " << occluded_count << " occluded, " << instance_count - occluded_count
+			  << " drawn, tested in " << test_ms << " ms" << (wrong > 0 ? ", some wrongly occluded" : "") << std::endl;
+	std::cout << "skinning one instance takes " << skinning_ms << " ms, skipping the occluded ones saves "
+			  << skinning_ms * occluded_count << " ms" << std::endl;
 }
 
-matrix4 convert_assimp_matrix(const aiMatrix4x4& mat)
-{
-	matrix4 ret;
-
-//	ret(0, 0) = mat.a1;
-//	ret(0, 1) = mat.b1;
-//	ret(0, 2) = mat.c1;
-//	ret(0, 3) = mat.d1;
-//	ret(1, 0) = mat.a2;
-//	ret(1, 1) = mat.b2;
-//	ret(1, 2) = mat.c2;
-//	ret(1, 3) = mat.d2;
-//	ret(2, 0) = mat.a3;
-//	ret(2, 1) = mat.b3;
-//	ret(2, 2) = mat.c3;
-//	ret(2, 3) = mat.d3;
-//	ret(3, 0) =	mat.a4;
-//	ret(3, 1) = mat.b4;
-//	ret(3, 2) = mat.c4;
-//	ret(3, 3) = mat.d4;
-
-	ret(0, 0) = mat.a1;
-	ret(0, 1) = mat.a2;
-	ret(0, 2) = mat.a3;
-	ret(0, 3) = mat.a4;
-	ret(1, 0) = mat.b1;
-	ret(1, 1) = mat.b2;
-	ret(1, 2) = mat.b3;
-	ret(1, 3) = mat.b4;
-	ret(2, 0) = mat.c1;
-	ret(2, 1) = mat.c2;
-	ret(2, 2) = mat.c3;
-	ret(2, 3) = mat.c4;
-	ret(3, 0) =	mat.d1;
-	ret(3, 1) = mat.d2;
-	ret(3, 2) = mat.d3;
-	ret(3, 3) = mat.d4;
+// GL calls of a frame with several models, drawn right away in tree order
+// and through the render queue, with and without leaving out the calls
+// that do not change the GL state, then with vertex array objects
+void benchmark_render_queue()
+{
+	const char* path = "trinity.x";
+	const int model_count = 8;
+	hidden_gl_context gl;
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, default_import_flags);
 
-	return ret;
-}
+	if (scene == nullptr)
+	{
+		std::cout << "could not import " << path << ": " << importer.GetErrorString() << std::endl;
+		return;
+	}
 
-void load_mesh_from_assimp_node(model_node** mesh_node, const aiNode* assimp_node, const aiScene* scene)
-{
-	for (const unsigned* iter = assimp_node->mMeshes; iter < assimp_node->mMeshes + assimp_node->mNumMeshes; ++iter)
+	std::vector<model*> models;
+
+	for (int i = 0; i < model_count; ++i)
 	{
-		int vertex_count = scene->mMeshes[*iter]->mNumVertices;
-		// assume all faces to be triangles
-		int index_count = scene->mMeshes[*iter]->mNumFaces * 3;
+		models.push_back(load_from_assimp_scene(scene));
+	}
 
-		if (vertex_count == 0 || index_count == 0)
-		{
-			continue;
-		}
+	render_view view;
+	view.pixels_per_unit = resize(800, 600);
+	view.culling = false;
+	glLoadIdentity();
+	glTranslatef(0.0f, -40.0f, -100.0f);
+
+	render_queue queue;
+	std::cout << model_count << " models" << std::endl;
 
-		// not sure how to handle different vertex formats
-		// maybe just assume position + texture coords + normals?
-		// what does wme do?
-		int vertex_size = 5 * sizeof(float);
-		uint8_t* vertex_data = new uint8_t[vertex_count * vertex_size];
-		uint8_t* vertex_data_begin = vertex_data;
-		uint16_t* index_data = new uint16_t[index_count];
-		uint16_t* index_data_begin = index_data;
+	for (int i = 0; i < 6; ++i)
+	{
+		bool queued = i % 2 == 1;
+		view.gl.filtering = i >= 2;
+		view.gl.vertex_arrays = i >= 4 && vertex_arrays_available();
 
-		for (const aiVector3D* iter2 = scene->mMeshes[*iter]->mVertices;
-			 iter2 < scene->mMeshes[*iter]->mVertices + vertex_count; ++iter2)
+		double ms = measure_ms(20, [&]()
 		{
-			vertex_data += 8;
-			*reinterpret_cast<float*>(vertex_data) = iter2->x;
-			vertex_data += 4;
-			*reinterpret_cast<float*>(vertex_data) = iter2->y;
-			vertex_data += 4;
-			*reinterpret_cast<float*>(vertex_data) = iter2->z;
-			vertex_data += 4;
-		}
+			view.reset_stats();
+			view.gl.invalidate();
+			queue.clear();
 
-		vertex_data = vertex_data_begin;
+			for (std::vector<model*>::iterator iter = models.begin(); iter != models.end(); ++iter)
+			{
+				if (queued)
+				{
+					(*iter)->render(view, queue);
+				}
+				else
+				{
+					(*iter)->render(view);
+				}
+			}
 
-		for (const aiVector3D* iter2 = scene->mMeshes[*iter]->mTextureCoords[0];
-			 iter2 < scene->mMeshes[*iter]->mTextureCoords[0] + vertex_count; ++iter2)
-		{
-			*reinterpret_cast<float*>(vertex_data) = iter2->x;
-			vertex_data += 4;
-			*reinterpret_cast<float*>(vertex_data) = iter2->y;
-			vertex_data += 16;
-		}
+			queue.submit(view.gl);
+			glFinish();
+		});
 
-		for (const aiFace* iter2 = scene->mMeshes[*iter]->mFaces;
-			 iter2 < scene->mMeshes[*iter]->mFaces + scene->mMeshes[*iter]->mNumFaces; ++iter2)
-		{
-			// again, assume all faces to be triangles
-			*index_data = *iter2->mIndices;
-			++index_data;
-			*index_data = *(iter2->mIndices+1);
-			++index_data;
-			*index_data = *(iter2->mIndices+2);
-			++index_data;
-		}
+		std::cout << (queued ? "render queue" : "tree order") << (view.gl.filtering ? ", filtered" : "")
+				  << (view.gl.vertex_arrays ? ", vertex arrays: " : ": ")
+				  << view.gl.issued << " GL calls, " << view.gl.filtered << " left out, " << ms << " ms" << std::endl;
+	}
+
+	for (std::vector<model*>::iterator iter = models.begin(); iter != models.end(); ++iter)
+	{
+		delete *iter;
+	}
+}
+
+// GL calls of a frame with several models through the render queue, with
+// a buffer pair per mesh, the meshes of each model sharing buffers and all
+// meshes sharing them, merged into multi-draws or not
+void benchmark_shared_buffers()
+{
+	const char* path = "trinity.x";
+	const int model_count = 8;
+	hidden_gl_context gl;
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, default_import_flags);
 
-		aiMaterial* assimp_mat = scene->mMaterials[scene->mMeshes[*iter]->mMaterialIndex];
+	if (scene == nullptr)
+	{
+		std::cout << "could not import " << path << ": " << importer.GetErrorString() << std::endl;
+		return;
+	}
 
-		aiColor3D diffuse;
-		assimp_mat->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse);
-		aiColor3D emissive;
-		assimp_mat->Get(AI_MATKEY_COLOR_EMISSIVE, emissive);
-		aiColor3D ambient;
-		assimp_mat->Get(AI_MATKEY_COLOR_AMBIENT, ambient);
-		aiColor3D specular;
-		assimp_mat->Get(AI_MATKEY_COLOR_SPECULAR, specular);
+	if (!base_vertex_available())
+	{
+		std::cout << "drawing with a base vertex is not supported" << std::endl;
+		return;
+	}
 
-		material* mat = new material;
-		mat->diffuse[0] = diffuse.r;
-		mat->diffuse[1] = diffuse.g;
-		mat->diffuse[2] = diffuse.b;
-		mat->diffuse[3] = 1.0f;
+	render_view view;
+	view.pixels_per_unit = resize(800, 600);
+	view.culling = false;
+	view.gl.vertex_arrays = vertex_arrays_available();
+	glLoadIdentity();
+	glTranslatef(0.0f, -40.0f, -100.0f);
 
-		mat->emissive[0] = emissive.r;
-		mat->emissive[1] = emissive.g;
-		mat->emissive[2] = emissive.b;
-		mat->emissive[3] = 1.0f;
+	const char* names[] = {"own buffers", "shared per model", "shared by all models", "shared by all models, not merged"};
+	render_queue queue;
+	std::cout << model_count << " models" << std::endl;
 
-		mat->ambient[0] = ambient.r;
-		mat->ambient[1] = ambient.g;
-		mat->ambient[2] = ambient.b;
-		mat->ambient[3] = 1.0f;
+	for (int i = 0; i < 4; ++i)
+	{
+		gl_task_list gl_tasks;
+		geometry_pool pool;
+		std::vector<model*> models;
 
-		mat->specular[0] = specular.r;
-		mat->specular[1] = specular.g;
-		mat->specular[2] = specular.b;
-		mat->specular[3] = 1.0f;
+		for (int j = 0; j < model_count; ++j)
+		{
+			models.push_back(prepare_assimp_scene(scene, default_vertex_attributes, nullptr, gl_tasks));
 
-		assimp_mat->Get(AI_MATKEY_SHININESS, mat->shininess);
+			if (i == 1)
+			{
+				gl_tasks.insert(gl_tasks.begin(), std::bind(&geometry_pool::create_buffers, models.back()->share_buffers()));
+			}
+			else if (i >= 2)
+			{
+				models.back()->share_buffers(pool);
+			}
+		}
 
-		for (int i = 0 ; i < assimp_mat->GetTextureCount(aiTextureType_DIFFUSE); ++i)
+		if (i >= 2)
 		{
-			aiString texture_path;
-			assimp_mat->Get(AI_MATKEY_TEXTURE(aiTextureType_DIFFUSE, i), texture_path);
-			mat->tex = load_texture(texture_path.C_Str());
+			gl_tasks.insert(gl_tasks.begin(), std::bind(&geometry_pool::create_buffers, &pool));
 		}
 
-		std::vector<bone> bones;
+		run_gl_tasks(gl_tasks);
+		queue.batching = i != 3;
 
-		for (auto iter2 = scene->mMeshes[*iter]->mBones; iter2 < scene->mMeshes[*iter]->mBones + scene->mMeshes[*iter]->mNumBones; ++iter2)
+		double ms = measure_ms(20, [&]()
 		{
-			bones.push_back(bone());
-			bones.back().node_ref = (*iter2)->mName.C_Str();
+			view.reset_stats();
+			view.gl.invalidate();
+			queue.clear();
 
-			for (auto iter3 = (*iter2)->mWeights; iter3 < (*iter2)->mWeights + (*iter2)->mNumWeights; ++iter3)
+			for (std::vector<model*>::iterator iter = models.begin(); iter != models.end(); ++iter)
 			{
-				bones.back().vertices.push_back(std::make_pair(iter3->mVertexId, iter3->mWeight));
+				(*iter)->render(view, queue);
 			}
 
-			bones.back().transform = convert_assimp_matrix((*iter2)->mOffsetMatrix);
-		}
+			queue.submit(view.gl);
+			glFinish();
+		});
 
-		*mesh_node = new model_node;
-		(*mesh_node)->m = new mesh(vertex_data_begin, vertex_count, vertex_size,
-								   index_data_begin, index_count, sizeof(uint16_t),
-								   bones);
-		(*mesh_node)->mat = mat;
-		mesh_node = &(*mesh_node)->next_sibling;
+		std::cout << names[i] << ": " << view.gl.issued << " GL calls, " << view.gl.draw_calls << " draws, " << ms << " ms" << std::endl;
+
+		for (std::vector<model*>::iterator iter = models.begin(); iter != models.end(); ++iter)
+		{
+			delete *iter;
+		}
 	}
 }
 
-model_node* traverse_assimp_scene(const aiNode* curr, const aiScene* scene)
+// a frame with many models through the render queue, one draw per mesh
+// against the draws of each model merged into one call, from client memory
+// and from an indirect buffer. headless on Mesa with
+// LIBGL_ALWAYS_SOFTWARE=1 xvfb-run, which makes llvmpipe do the drawing.
+void benchmark_indirect()
 {
-	model_node* ret = new model_node;
-	model_node** curr_child = &ret->first_child;
+	const char* path = "trinity.x";
+	const int model_count = 64;
+	hidden_gl_context gl;
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, default_import_flags);
 
-	for (aiNode** iter = curr->mChildren;  iter < curr->mChildren + curr->mNumChildren; ++iter)
+	if (scene == nullptr)
 	{
-		*curr_child = traverse_assimp_scene(*iter, scene);
-		curr_child = &((*curr_child)->next_sibling);
+		std::cout << "could not import " << path << ": " << importer.GetErrorString() << std::endl;
+		return;
 	}
 
-	load_mesh_from_assimp_node(curr_child, curr, scene);
-	ret->name = curr->mName.C_Str();
+	if (!base_vertex_available() || !indirect_draw_available())
+	{
+		std::cout << "indirect drawing is not supported" << std::endl;
+		return;
+	}
 
-	ret->transform = convert_assimp_matrix(curr->mTransformation);
-	ret->original_transform = ret->transform;
+	// says whether llvmpipe or the GPU draws
+	const GLubyte* renderer = glGetString(GL_RENDERER);
+	std::cout << (renderer != nullptr ? reinterpret_cast<const char*>(renderer) : "unknown renderer") << ", "
+			  << model_count << " models" << std::endl;
 
-	return ret;
-}
+	gl_task_list gl_tasks;
+	std::vector<model*> models;
 
-model* load_from_assimp_scene(const aiScene* scene)
-{
-	model_node* root = traverse_assimp_scene(scene->mRootNode, scene);
-	std::vector<animation_set> anim_sets;
+	for (int i = 0; i < model_count; ++i)
+	{
+		models.push_back(prepare_assimp_scene(scene, default_vertex_attributes, nullptr, gl_tasks));
+		gl_tasks.insert(gl_tasks.begin(), std::bind(&geometry_pool::create_buffers, models.back()->share_buffers()));
+	}
 
-	aiMatrix4x4 ai_global_inverse = scene->mRootNode->mTransformation.Inverse();
-	matrix4 global_inverse;
+	run_gl_tasks(gl_tasks);
 
-	global_inverse = convert_assimp_matrix(ai_global_inverse);
-	double ticks_per_second = 0.0;
+	render_view view;
+	view.pixels_per_unit = resize(800, 600);
+	view.culling = false;
+	view.gl.vertex_arrays = vertex_arrays_available();
+	glLoadIdentity();
+	glTranslatef(0.0f, -40.0f, -100.0f);
 
-	for (aiAnimation** iter = scene->mAnimations; iter < scene->mAnimations + scene->mNumAnimations; ++iter)
+	const char* names[] = {"per mesh", "glMultiDrawElementsBaseVertex", "glMultiDrawElementsIndirect"};
+	render_queue queue;
+
+	for (int i = 0; i < 3; ++i)
 	{
-		anim_sets.resize(anim_sets.size() + 1);
-		anim_sets.back().first = std::string((*iter)->mName.C_Str());
-		ticks_per_second = (*iter)->mTicksPerSecond;
+		queue.batching = i >= 1;
+		queue.indirect = i == 2;
 
-		for (aiNodeAnim** iter2 = (*iter)->mChannels; iter2 < (*iter)->mChannels + (*iter)->mNumChannels; ++iter2)
+		double ms = measure_ms(20, [&]()
 		{
-			anim_sets.back().second.push_back(animation());
-			anim_sets.back().second.back().node_ref = std::string((*iter2)->mNodeName.C_Str());
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			view.reset_stats();
+			view.gl.invalidate();
+			queue.clear();
 
-			for (aiVectorKey* iter3 = (*iter2)->mPositionKeys; iter3 < (*iter2)->mPositionKeys + (*iter2)->mNumPositionKeys; ++iter3)
+			for (std::vector<model*>::iterator iter = models.begin(); iter != models.end(); ++iter)
 			{
-				anim_sets.back().second.back().pos_keys.resize(anim_sets.back().second.back().pos_keys.size() + 1);
-				anim_sets.back().second.back().pos_keys.back().first = iter3->mTime;
-				anim_sets.back().second.back().pos_keys.back().second.x = iter3->mValue.x;
-				anim_sets.back().second.back().pos_keys.back().second.y = iter3->mValue.y;
-				anim_sets.back().second.back().pos_keys.back().second.z = iter3->mValue.z;
+				(*iter)->render(view, queue);
 			}
 
-			for (aiVectorKey* iter3 = (*iter2)->mScalingKeys; iter3 < (*iter2)->mScalingKeys + (*iter2)->mNumScalingKeys; ++iter3)
-			{
-				anim_sets.back().second.back().scale_keys.resize(anim_sets.back().second.back().scale_keys.size() + 1);
-				anim_sets.back().second.back().scale_keys.back().first = iter3->mTime;
-				anim_sets.back().second.back().scale_keys.back().second.x = iter3->mValue.x;
-				anim_sets.back().second.back().scale_keys.back().second.y = iter3->mValue.y;
-				anim_sets.back().second.back().scale_keys.back().second.z = iter3->mValue.z;
-			}
+			queue.submit(view.gl);
+			glFinish();
+		});
 
-			for (aiQuatKey* iter3 = (*iter2)->mRotationKeys; iter3 < (*iter2)->mRotationKeys + (*iter2)->mNumRotationKeys; ++iter3)
-			{
-				anim_sets.back().second.back().rot_keys.resize(anim_sets.back().second.back().rot_keys.size() + 1);
-				anim_sets.back().second.back().rot_keys.back().first = iter3->mTime;
-				anim_sets.back().second.back().rot_keys.back().second.w = iter3->mValue.w;
-				anim_sets.back().second.back().rot_keys.back().second.x = iter3->mValue.x;
-				anim_sets.back().second.back().rot_keys.back().second.y = iter3->mValue.y;
-				anim_sets.back().second.back().rot_keys.back().second.z = iter3->mValue.z;
-			}
-		}
+		std::cout << names[i] << ": " << view.gl.issued << " GL calls, " << view.gl.draw_calls << " draws, " << ms << " ms" << std::endl;
 	}
 
-	return new model(root, global_inverse, anim_sets, ticks_per_second);
+	for (std::vector<model*>::iterator iter = models.begin(); iter != models.end(); ++iter)
+	{
+		delete *iter;
+	}
 }
 
-std::pair<std::vector<vertex>, std::vector<GLushort>> create_circle_mesh_data(int resolution)
+// compares the longest stall of the render thread for a blocking load with
+// one where the model streams in through model_loader
+void benchmark_async_load()
 {
-	std::vector<GLushort> indexData(3*resolution);
-	std::vector<vertex> vertexData(resolution + 1);
+	const char* path = "trinity.x";
+	hidden_gl_context gl;
+	worker_pool pool(std::max(1u, std::thread::hardware_concurrency()));
 
-	vertexData.front() = { vector3(1.0f, 0.0f, 0.0f), vector3(0.0f, 0.0f, -5.0f) };
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	delete load_model(path, import_options(), nullptr, &pool);
+	double blocking_ms = elapsed_ms(begin);
 
-	float angleStep = (2*M_PI) / (resolution);
+	gl_upload_queue uploads;
+	model_loader loader(uploads, import_options(), nullptr, &pool);
+	std::future<model*> pending_model = loader.load_async(path);
 
-	for (int i = 0; i < resolution; ++i)
-	{
-		float x_coord = cos(i*angleStep);
-		float y_coord = sin(i*angleStep);
-		vertexData[i+1].pos =  vector3(x_coord, y_coord, -5.0f);
-		vertexData[i+1].color = vector3(1.0f, 0.0f, 0.0f);
-	}
+	const double upload_budget_ms = 1.0;
+	double longest_frame_ms = 0.0;
+	int frames = 0;
+	int tasks = 0;
 
-	for (int i = 0; i < resolution - 1; ++i)
+	begin = std::chrono::steady_clock::now();
+
+	while (pending_model.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
 	{
-		int pos = i * 3;
-		indexData[pos] = 0;
-		indexData[pos + 1] = i + 1;
-		indexData[pos + 2] = i + 2;
+		std::chrono::steady_clock::time_point frame_begin = std::chrono::steady_clock::now();
+		tasks += uploads.drain(upload_budget_ms);
+		longest_frame_ms = std::max(longest_frame_ms, elapsed_ms(frame_begin));
+		++frames;
+
+		// the rest of a frame
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
 	}
 
-	indexData[(resolution - 1) * 3] = 0;
-	indexData[(resolution - 1) * 3 + 1] = resolution;
-	indexData[(resolution - 1) * 3 + 2] = 1;
+	double async_ms = elapsed_ms(begin);
+	delete pending_model.get();
 
-	return std::make_pair(vertexData, indexData);
+	std::cout << "async load, " << path << std::endl;
+	std::cout << "  blocking load: " << blocking_ms << " ms on the render thread" << std::endl;
+	std::cout << "  streamed:      " << async_ms << " ms over " << frames << " frames, " << tasks
+			  << " GL tasks, longest upload per frame " << longest_frame_ms << " ms (budget " << upload_budget_ms << " ms)" << std::endl;
 }
 
-void resize(int width, int height)
+typedef std::pair<std::string, void (*)()> benchmark;
+
+// headless benchmarks, selected with --benchmark <name> or --benchmark all
+const std::vector<benchmark>& benchmarks()
 {
-	float horizontal_view_angle = M_PI * 0.5f;
-	float aspect_ratio = float(height) / float(width);
-	float near_plane = 1.0f;
-	float far_plane = 1000.0f;
-	float right = near_plane * tanf(horizontal_view_angle * 0.5f);
+	static const std::vector<benchmark> ret =
+	{
+		benchmark("transform_chain", benchmark_transform_chain),
+		benchmark("scene_update", benchmark_scene_update),
+		benchmark("model_load", benchmark_model_load),
+		benchmark("async_load", benchmark_async_load),
+		benchmark("import_profiles", benchmark_import_profiles),
+		benchmark("vertex_formats", benchmark_vertex_formats),
+		benchmark("vertex_cache", benchmark_vertex_cache),
+		benchmark("lods", benchmark_lods),
+		benchmark("culling", benchmark_culling),
+		benchmark("bvh", benchmark_bvh),
+		benchmark("occlusion", benchmark_occlusion),
+		benchmark("render_queue", benchmark_render_queue),
+		benchmark("shared_buffers", benchmark_shared_buffers),
+		benchmark("indirect", benchmark_indirect)
+	};
 
-	glViewport(0, 0, width, height);
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	glFrustum(-right, right, -right*aspect_ratio, right*aspect_ratio, near_plane, far_plane);
-	glMatrixMode(GL_MODELVIEW);
+	return ret;
 }
 
+int run_benchmarks(const std::string& name)
+{
+	bool found = false;
+
+	for (std::vector<benchmark>::const_iterator iter = benchmarks().begin(); iter != benchmarks().end(); ++iter)
+	{
+		if (name == "all" || name == iter->first)
+		{
+			iter->second();
+			found = true;
+		}
+	}
+
+	if (!found)
+	{
+		std::cout << "unknown benchmark " << name << ", available:";
+
+		for (std::vector<benchmark>::const_iterator iter = benchmarks().begin(); iter != benchmarks().end(); ++iter)
+		{
+			std::cout << " " << iter->first;
+		}
+
+		std::cout << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
 
-int main()
+int main(int argc, char* argv[])
 {
-	Assimp::Importer importer;
+	if (argc > 2 && std::string(argv[1]) == "--benchmark")
+	{
+		return run_benchmarks(argv[2]);
+	}
+
+	std::string model_path = "trinity.x";
+	bool use_import_cache = true;
+	bool lighting = false;
+	bool print_render_stats = false;
+	bool culling = true;
+	bool occlusion_culling = false;
+	bool use_render_queue = true;
+	bool use_vertex_arrays = true;
+	bool indirect_draws = false;
+	float lod_error_pixels = 1.0f;
+	import_options options;
+	std::string cook_in;
+	std::string cook_out;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string(argv[i]) == "--model" && i + 1 < argc)
+		{
+			model_path = argv[++i];
+		}
+		else if (std::string(argv[i]) == "--no-import-cache")
+		{
+			use_import_cache = false;
+		}
+		else if (std::string(argv[i]) == "--profile" && i + 1 < argc)
+		{
+			const import_profile* profile = find_import_profile(argv[++i]);
+
+			if (profile == nullptr)
+			{
+				std::cout << "unknown import profile " << argv[i] << ", available:";
+
+				for (int j = 0; j < import_profile_count; ++j)
+				{
+					std::cout << " " << import_profiles[j].name;
+				}
+
+				std::cout << std::endl;
+				return 1;
+			}
+
+			options.flags = profile->flags;
+		}
+		else if (std::string(argv[i]) == "--import-timing")
+		{
+			options.time_stages = true;
+		}
+		else if (std::string(argv[i]) == "--lod-error" && i + 1 < argc)
+		{
+			lod_error_pixels = std::atof(argv[++i]);
+		}
+		else if (std::string(argv[i]) == "--render-stats")
+		{
+			print_render_stats = true;
+		}
+		else if (std::string(argv[i]) == "--no-culling")
+		{
+			culling = false;
+		}
+		else if (std::string(argv[i]) == "--occlusion")
+		{
+			occlusion_culling = true;
+		}
+		else if (std::string(argv[i]) == "--no-render-queue")
+		{
+			use_render_queue = false;
+		}
+		else if (std::string(argv[i]) == "--no-vertex-arrays")
+		{
+			use_vertex_arrays = false;
+		}
+		else if (std::string(argv[i]) == "--shared-buffers")
+		{
+			options.shared_buffers = true;
+		}
+		else if (std::string(argv[i]) == "--indirect-draws")
+		{
+			// only draws from shared buffers are merged
+			options.shared_buffers = true;
+			indirect_draws = true;
+		}
+		else if (std::string(argv[i]) == "--compress-vertices")
+		{
+			options.vertex_attributes |= vertex_compressed;
+		}
+		else if (std::string(argv[i]) == "--lighting")
+		{
+			// only lit rendering needs the normals
+			options.vertex_attributes |= vertex_normal;
+			lighting = true;
+		}
+		else if (std::string(argv[i]) == "--cook" && i + 2 < argc)
+		{
+			cook_in = argv[++i];
+			cook_out = argv[++i];
+		}
+	}
+
+	if (!cook_in.empty())
+	{
+		return cook_model_file(cook_in.c_str(), cook_out.c_str(), options) ? 0 : 1;
+	}
 
-	const aiScene* scene = importer.ReadFile("trinity.x",
-											 aiProcess_CalcTangentSpace       |
-											 aiProcess_Triangulate            |
-											 aiProcess_JoinIdenticalVertices  |
-											 aiProcess_SortByPType);
+	import_cache* cache = use_import_cache ? new import_cache("import_cache", 256 * 1024 * 1024) : nullptr;
 
 	SDL_Init(SDL_INIT_VIDEO);
 
@@ -1141,7 +4833,18 @@ int main()
 
 	glewInit();
 
-	resize(800, 600);
+	render_view view;
+	view.pixels_per_unit = resize(800, 600);
+	view.max_error_pixels = lod_error_pixels;
+	view.culling = culling;
+	view.gl.vertex_arrays = use_vertex_arrays && vertex_arrays_available();
+	options.shared_buffers = options.shared_buffers && base_vertex_available();
+	uint32_t last_render_stats = 0;
+
+	// a quarter of the window in each direction
+	occlusion_buffer* occlusion = occlusion_culling ? new occlusion_buffer(200, 150) : nullptr;
+	render_queue queue;
+	queue.indirect = indirect_draws && indirect_draw_available();
 
 	SDL_Event event;
 	bool running = true;
@@ -1151,20 +4854,40 @@ int main()
 //	mesh circle(circleData.first.data(), circleData.first.size(), sizeof(vertex),
 //				circleData.second.data(), circleData.second.size(), sizeof(GLushort));
 
-	model* test = load_from_assimp_scene(scene);
+	worker_pool pool(std::max(1u, std::thread::hardware_concurrency()));
+
+	// the model streams in while the loop below is already rendering
+	gl_upload_queue uploads;
+	model_loader* loader = new model_loader(uploads, options, cache, &pool);
+	std::future<model*> pending_model = loader->load_async(model_path);
+	model* test = nullptr;
+	// time per frame the GL uploads may take
+	const double upload_budget_ms = 4.0;
 
-	matrix4 mat = translation(vector3(-15.0f, 10.0f, -90.0f));
+	constexpr matrix4 mat = translation(vector3(-15.0f, 10.0f, -90.0f));
 	glLoadIdentity();
 	glTranslatef(0.0f, -40.0f, -100.0f);
 	//glLoadMatrixf(mat.elements);
 
 	glEnable(GL_DEPTH_TEST);
 	glEnable(GL_TEXTURE_2D);
-	glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+
+	if (lighting)
+	{
+		// skinned normals are not unit length
+		glEnable(GL_LIGHTING);
+		glEnable(GL_LIGHT0);
+		glEnable(GL_NORMALIZE);
+		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+	}
+	else
+	{
+		glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+	}
 
 	float delta = 0.0f;
 
-	test->play_anim("walk");
+	std::vector<model*> models;
 
 	while(running)
 	{
@@ -1183,17 +4906,94 @@ int main()
 		glClearColor(0.2f, 0.4f, 0.2f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		test->render();
+		view.reset_stats();
+		// uploads between the frames bind buffers and textures
+		view.gl.invalidate();
+		queue.clear();
+
+		for (std::vector<model*>::iterator iter = models.begin(); iter != models.end(); ++iter)
+		{
+			if (use_render_queue)
+			{
+				(*iter)->render(view, queue);
+			}
+			else
+			{
+				(*iter)->render(view);
+			}
+		}
+
+		queue.submit(view.gl);
+
+		if (print_render_stats && time_elapsed_begin - last_render_stats >= 1000)
+		{
+			std::cout << view.gl.issued << " GL calls (" << view.gl.draw_calls << " draws, " << view.gl.filtered << " redundant left out), " << view.culled << " mesh(es) culled, " << view.occluded
+					  << " occluded, triangles per level of detail:";
+
+			for (int i = 0; i < max_lod_count; ++i)
+			{
+				std::cout << " " << view.triangles[i] << " (" << view.draws[i] << " draws)";
+			}
+
+			std::cout << std::endl;
+			last_render_stats = time_elapsed_begin;
+		}
 
 		SDL_GL_SwapWindow(window);
 
-		test->update(delta);
+		uploads.drain(upload_budget_ms);
+
+		if (pending_model.valid() && pending_model.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+		{
+			test = pending_model.get();
+
+			if (test == nullptr)
+			{
+				std::cout << "could not load " << model_path << std::endl;
+				running = false;
+				continue;
+			}
+
+			if (cache != nullptr)
+			{
+				std::cout << "import cache: " << cache->hits() << " hit(s), " << cache->misses() << " miss(es), "
+						  << cache->size() << " of " << cache->limit() << " bytes used" << std::endl;
+			}
+
+			const arena* storage = test->get_storage();
+			std::cout << "model data: " << storage->allocation_count() << " allocations, "
+					  << storage->allocated_bytes() << " bytes in " << storage->block_count() << " block(s) of "
+					  << storage->reserved_bytes() << " bytes" << std::endl;
+
+			size_t saved_gpu_bytes;
+			size_t saved_cpu_bytes;
+			test->shared_mesh_savings(saved_gpu_bytes, saved_cpu_bytes);
+			std::cout << "meshes: " << test->mesh_count() << " for " << test->mesh_reference_count() << " node references, sharing saved "
+					  << saved_gpu_bytes << " GPU bytes and " << saved_cpu_bytes << " CPU bytes" << std::endl;
+
+			test->play_anim("walk");
+			models.push_back(test);
+		}
+
+		// the camera does not move, so this is also the frustum of the next
+		// frame, which draws what is skinned here
+		frustum visible = gl_view_frustum();
+
+		if (occlusion != nullptr)
+		{
+			occlusion->clear(gl_matrix(GL_PROJECTION_MATRIX) * gl_matrix(GL_MODELVIEW_MATRIX));
+		}
+
+		update_models(models, delta, pool, culling ? &visible : nullptr, occlusion);
 
 		uint32_t time_elapsed_end = SDL_GetTicks();
 		delta = static_cast<float>(time_elapsed_end - time_elapsed_begin) / 1000.0f;
 	}
 
+	delete loader;
 	delete test;
+	delete cache;
+	delete occlusion;
 
 	SDL_GL_DeleteContext(glContext);
 	SDL_Quit();
@@ -0,0 +1,227 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "vector_math.h"
+
+// low resolution depth buffer on the CPU. a few large occluders are drawn
+// into it, then the bounds of everything else are tested against it before
+// the work to animate and draw them is spent. does not touch GL.
+//
+// the buffer holds 1 / w, which is linear in screen space, 0 where nothing
+// was drawn. the rows are plain float arrays and the inner loops have no
+// branches, so the compiler can vectorize them like the skinning loop in
+// transform_vectors_weighted.
+class occlusion_buffer
+{
+public:
+	occlusion_buffer(int width, int height)
+		: width(width), height(height), depth(width * height, 0.0f)
+	{
+
+	}
+
+	occlusion_buffer(const occlusion_buffer& ) = delete;
+	occlusion_buffer& operator=(const occlusion_buffer& ) = delete;
+	occlusion_buffer(occlusion_buffer&& ) = delete;
+	occlusion_buffer& operator=(occlusion_buffer&& ) = delete;
+
+	// starts a frame, positions given to the other functions are
+	// transformed by view_projection
+	void clear(const matrix4& view_projection)
+	{
+		this->view_projection = view_projection;
+		std::fill(depth.begin(), depth.end(), 0.0f);
+	}
+
+	// triangles crossing the near plane are left out, occluders only ever
+	// cover less than they should. a pixel counts as covered only if the
+	// triangle covers all of it, and gets the farthest 1 / w over it.
+	void rasterize_triangle(const vector3& a, const vector3& b, const vector3& c)
+	{
+		float x[3];
+		float y[3];
+		float inverse_w[3];
+
+		if (!project(a, x[0], y[0], inverse_w[0]) || !project(b, x[1], y[1], inverse_w[1]) || !project(c, x[2], y[2], inverse_w[2]))
+		{
+			return;
+		}
+
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+
+		if (std::fabs(area) < 1e-8f)
+		{
+			return;
+		}
+
+		// both windings occlude, make the edge functions positive inside
+		if (area < 0.0f)
+		{
+			std::swap(x[1], x[2]);
+			std::swap(y[1], y[2]);
+			std::swap(inverse_w[1], inverse_w[2]);
+			area = -area;
+		}
+
+		int min_x = std::max(0, static_cast<int>(std::floor(std::fmin(x[0], std::fmin(x[1], x[2])))));
+		int max_x = std::min(width - 1, static_cast<int>(std::ceil(std::fmax(x[0], std::fmax(x[1], x[2])))));
+		int min_y = std::max(0, static_cast<int>(std::floor(std::fmin(y[0], std::fmin(y[1], y[2])))));
+		int max_y = std::min(height - 1, static_cast<int>(std::ceil(std::fmax(y[0], std::fmax(y[1], y[2])))));
+
+		// edge i is opposite of vertex i, e(px, py) = ex * px + ey * py + e0
+		float ex[3];
+		float ey[3];
+		float e0[3];
+
+		for (int i = 0; i < 3; ++i)
+		{
+			int j = (i + 1) % 3;
+			int k = (i + 2) % 3;
+			ex[i] = y[j] - y[k];
+			ey[i] = x[k] - x[j];
+			e0[i] = x[j] * y[k] - x[k] * y[j];
+		}
+
+		// 1 / w as a plane over the screen, from the barycentric weights
+		float dx = (ex[0] * inverse_w[0] + ex[1] * inverse_w[1] + ex[2] * inverse_w[2]) / area;
+		float dy = (ey[0] * inverse_w[0] + ey[1] * inverse_w[1] + ey[2] * inverse_w[2]) / area;
+		float d0 = (e0[0] * inverse_w[0] + e0[1] * inverse_w[1] + e0[2] * inverse_w[2]) / area;
+
+		// the corner of a pixel furthest outside each edge, and the one
+		// where 1 / w is smallest
+		float corner_x[3];
+		float corner_y[3];
+
+		for (int i = 0; i < 3; ++i)
+		{
+			corner_x[i] = ex[i] < 0.0f ? 1.0f : 0.0f;
+			corner_y[i] = ey[i] < 0.0f ? 1.0f : 0.0f;
+		}
+
+		float far_x = dx < 0.0f ? 1.0f : 0.0f;
+		float far_y = dy < 0.0f ? 1.0f : 0.0f;
+
+		for (int py = min_y; py <= max_y; ++py)
+		{
+			float row0 = ey[0] * (py + corner_y[0]) + e0[0];
+			float row1 = ey[1] * (py + corner_y[1]) + e0[1];
+			float row2 = ey[2] * (py + corner_y[2]) + e0[2];
+			float row_depth = dy * (py + far_y) + d0;
+			float* row = depth.data() + py * width;
+
+			for (int px = min_x; px <= max_x; ++px)
+			{
+				bool inside = ex[0] * (px + corner_x[0]) + row0 >= 0.0f && ex[1] * (px + corner_x[1]) + row1 >= 0.0f &&
+							  ex[2] * (px + corner_x[2]) + row2 >= 0.0f;
+				float d = dx * (px + far_x) + row_depth;
+				row[px] = inside && d > row[px] ? d : row[px];
+			}
+		}
+	}
+
+	// true if every pixel the screen rectangle of box touches holds
+	// something nearer than the nearest corner of box
+	bool occluded(const bounding_box& box) const
+	{
+		float min_x = HUGE_VALF;
+		float max_x = -HUGE_VALF;
+		float min_y = HUGE_VALF;
+		float max_y = -HUGE_VALF;
+		float nearest = 0.0f;
+
+		for (int i = 0; i < 8; ++i)
+		{
+			vector3 corner(i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z);
+			float x;
+			float y;
+			float inverse_w;
+
+			// boxes reaching behind the camera cover the view
+			if (!project(corner, x, y, inverse_w))
+			{
+				return false;
+			}
+
+			min_x = std::fmin(min_x, x);
+			max_x = std::fmax(max_x, x);
+			min_y = std::fmin(min_y, y);
+			max_y = std::fmax(max_y, y);
+			nearest = std::fmax(nearest, inverse_w);
+		}
+
+		int begin_x = std::max(0, static_cast<int>(std::floor(min_x)));
+		int end_x = std::min(width - 1, static_cast<int>(std::floor(max_x)));
+		int begin_y = std::max(0, static_cast<int>(std::floor(min_y)));
+		int end_y = std::min(height - 1, static_cast<int>(std::floor(max_y)));
+
+		// off screen, that is for the frustum test to decide
+		if (begin_x > end_x || begin_y > end_y)
+		{
+			return false;
+		}
+
+		for (int py = begin_y; py <= end_y; ++py)
+		{
+			const float* row = depth.data() + py * width;
+			bool visible = false;
+
+			for (int px = begin_x; px <= end_x; ++px)
+			{
+				visible |= row[px] <= nearest;
+			}
+
+			if (visible)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	int get_width() const
+	{
+		return width;
+	}
+
+	int get_height() const
+	{
+		return height;
+	}
+
+	// 1 / w of the nearest occluder at the pixel, 0 if there is none
+	float depth_at(int x, int y) const
+	{
+		return depth[y * width + x];
+	}
+
+private:
+	// screen position in pixels and 1 / w, false if p is too close to or
+	// behind the camera
+	bool project(const vector3& p, float& x, float& y, float& inverse_w) const
+	{
+		const matrix4& m = view_projection;
+		float w = m(3, 0) * p.x + m(3, 1) * p.y + m(3, 2) * p.z + m(3, 3);
+
+		if (w < 1e-5f)
+		{
+			return false;
+		}
+
+		inverse_w = 1.0f / w;
+		x = ((m(0, 0) * p.x + m(0, 1) * p.y + m(0, 2) * p.z + m(0, 3)) * inverse_w * 0.5f + 0.5f) * width;
+		y = ((m(1, 0) * p.x + m(1, 1) * p.y + m(1, 2) * p.z + m(1, 3)) * inverse_w * 0.5f + 0.5f) * height;
+		return true;
+	}
+
+	int width;
+	int height;
+	matrix4 view_projection;
+	std::vector<float> depth;
+};
+
+#endif
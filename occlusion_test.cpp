@@ -0,0 +1,86 @@
+// checks occlusion_buffer without a GL context: a quad occluder in front of
+// the camera and boxes behind, in front of and around it
+
+#undef NDEBUG
+#include <cassert>
+#include <iostream>
+
+#include "occlusion.h"
+
+// the camera is at the origin looking down -z, like the GL default
+matrix4 test_view_projection()
+{
+	return frustum_projection(-0.1f, 0.1f, -0.075f, 0.075f, 0.1f, 1000.0f);
+}
+
+bounding_box make_box(const vector3& min, const vector3& max)
+{
+	bounding_box ret;
+	ret.add(min);
+	ret.add(max);
+	return ret;
+}
+
+// a square of a bit over 4 by 4 units at distance 10, covering the middle
+// of the view. its right edge lands at x = 120.6, past the center of
+// pixel 120 but not over all of it.
+void rasterize_quad(occlusion_buffer& occlusion)
+{
+	vector3 a(-2.06f, -2.06f, -10.0f);
+	vector3 b(2.06f, -2.06f, -10.0f);
+	vector3 c(2.06f, 2.06f, -10.0f);
+	vector3 d(-2.06f, 2.06f, -10.0f);
+
+	occlusion.rasterize_triangle(a, b, c);
+	// the other winding occludes too
+	occlusion.rasterize_triangle(a, d, c);
+}
+
+int main()
+{
+	occlusion_buffer occlusion(200, 150);
+	occlusion.clear(test_view_projection());
+
+	// nothing drawn yet, nothing is hidden
+	assert(!occlusion.occluded(make_box(vector3(-0.5f, -0.5f, -21.0f), vector3(0.5f, 0.5f, -20.0f))));
+
+	rasterize_quad(occlusion);
+
+	// 1 / w of the quad inside, nothing in the corners
+	assert(std::fabs(occlusion.depth_at(110, 65) - 0.1f) < 1e-4f);
+	assert(occlusion.depth_at(0, 0) == 0.0f);
+	assert(occlusion.depth_at(199, 149) == 0.0f);
+
+	// only pixels a triangle covers completely count, so neither half of
+	// the quad takes the ones on its diagonal, nor the one its edge cuts
+	assert(occlusion.depth_at(100, 75) == 0.0f);
+	assert(occlusion.depth_at(119, 75) > 0.0f);
+	assert(occlusion.depth_at(120, 75) == 0.0f);
+
+	// behind the lower right half of the quad
+	assert(occlusion.occluded(make_box(vector3(1.5f, -3.0f, -21.0f), vector3(3.0f, -1.5f, -20.0f))));
+	assert(occlusion.occluded(make_box(vector3(0.5f, -1.5f, -12.0f), vector3(1.5f, -0.5f, -11.0f))));
+
+	// in front of the quad
+	assert(!occlusion.occluded(make_box(vector3(-0.5f, -0.5f, -6.0f), vector3(0.5f, 0.5f, -5.0f))));
+
+	// cutting through the quad, its nearest corner is in front
+	assert(!occlusion.occluded(make_box(vector3(-0.5f, -0.5f, -12.0f), vector3(0.5f, 0.5f, -8.0f))));
+
+	// behind the quad but reaching past its edge on screen
+	assert(!occlusion.occluded(make_box(vector3(3.0f, -0.5f, -21.0f), vector3(5.0f, 0.5f, -20.0f))));
+
+	// behind the quad and reaching past its edge by less than a pixel, to
+	// x = 120.85
+	assert(!occlusion.occluded(make_box(vector3(3.0f, -0.5f, -21.0f), vector3(4.17f, 0.5f, -20.0f))));
+
+	// crossing the near plane, part of it is behind the camera
+	assert(!occlusion.occluded(make_box(vector3(-0.5f, -0.5f, -5.0f), vector3(0.5f, 0.5f, 1.0f))));
+
+	// clear() forgets the occluders
+	occlusion.clear(test_view_projection());
+	assert(!occlusion.occluded(make_box(vector3(-0.5f, -0.5f, -21.0f), vector3(0.5f, 0.5f, -20.0f))));
+
+	std::cout << "occlusion_buffer tests passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,610 @@
+#ifndef VECTOR_MATH_H
+#define VECTOR_MATH_H
+
+#include <cmath>
+
+struct vector3
+{
+	constexpr vector3()
+		: x(0.0f), y(0.0f), z(0.0f)
+	{
+
+	}
+
+	constexpr vector3(float x, float y, float z)
+		: x(x), y(y), z(z)
+	{
+
+	}
+
+	float x, y, z;
+};
+
+constexpr bool operator == (const vector3& v, const vector3& w)
+{
+	return v.x == w.x && v.y == w.y && v.z == w.z;
+}
+
+constexpr vector3 linear_interpolation(const vector3& v, const vector3& w, double lerp)
+{
+	return vector3((1 - lerp) * v.x + lerp * w.x, (1 - lerp) * v.y + lerp * w.y, (1 - lerp) * v.z + lerp * w.z);
+}
+
+constexpr vector3 operator + (const vector3& v, const vector3& w)
+{
+	return vector3(v.x + w.x, v.y + w.y, v.z + w.z);
+}
+
+constexpr vector3 operator - (const vector3& v, const vector3& w)
+{
+	return vector3(v.x - w.x, v.y - w.y, v.z - w.z);
+}
+
+constexpr vector3 operator * (const vector3& v, float s)
+{
+	return vector3(v.x * s, v.y * s, v.z * s);
+}
+
+constexpr float dot_product(const vector3& v, const vector3& w)
+{
+	return v.x * w.x + v.y * w.y + v.z * w.z;
+}
+
+constexpr vector3 cross_product(const vector3& v, const vector3& w)
+{
+	return vector3(v.y * w.z - v.z * w.y, v.z * w.x - v.x * w.z, v.x * w.y - v.y * w.x);
+}
+
+inline float vector_length(const vector3& v)
+{
+	return std::sqrt(dot_product(v, v));
+}
+
+struct quaternion
+{
+	constexpr quaternion()
+	{
+
+	}
+
+	constexpr quaternion(float w, float x, float y, float z)
+		: w(w), x(x), y(y), z(z)
+	{
+
+	}
+
+	float w = 0.0f;
+	float x = 0.0f;
+	float y = 0.0f;
+	float z = 0.0f;
+};
+
+constexpr double quaternion_dot_product(const quaternion& q1, const quaternion& q2)
+{
+	float ret =  q1.w * q2.w + q1.x * q2.x + q1.y * q2.y + q1.z * q2.z;
+	return ret;
+}
+
+inline double abs_quaternion(const quaternion& q)
+{
+	return std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+}
+
+constexpr quaternion operator * (const quaternion& q1, const quaternion q2)
+{
+	return quaternion(q1.w * q2.w - q1.x * q2.x - q1.y * q2.y - q1.z * q2.z,
+					  q1.w * q2.x + q1.x * q2.w + q1.y * q2.z - q1.z * q2.y,
+					  q1.w * q2.y - q1.x * q2.z + q1.y * q2.w + q1.z * q2.x,
+					  q1.w * q2.z + q1.x * q2.y - q1.y * q2.x + q1.z * q2.w);
+}
+
+inline quaternion spherical_linear_interpolation(const quaternion& q1, const quaternion& q2, float lerp)
+{
+	float tmp = quaternion_dot_product(q1, q2) / ((abs_quaternion(q1) * abs_quaternion(q2)));
+
+	// q2 and -q2 are the same rotation, take the one along the shorter arc
+	quaternion target = q2;
+
+	if (tmp < 0.0f)
+	{
+		target = quaternion(-q2.w, -q2.x, -q2.y, -q2.z);
+		tmp = -tmp;
+	}
+
+	// sin(theta) is too small to divide by, a normalized linear
+	// interpolation is as good this close
+	if (1.0f - tmp < 0.0001f)
+	{
+		quaternion ret((1 - lerp) * q1.w + lerp * target.w, (1 - lerp) * q1.x + lerp * target.x,
+					   (1 - lerp) * q1.y + lerp * target.y, (1 - lerp) * q1.z + lerp * target.z);
+		float length = abs_quaternion(ret);
+		return length > 0.0f ? quaternion(ret.w / length, ret.x / length, ret.y / length, ret.z / length) : q1;
+	}
+
+	float theta = std::acos(tmp);
+	float sin_theta = std::sin(theta);
+
+	float q1_weight = std::sin(theta * (1 - lerp)) / sin_theta;
+	float q2_weight = std::sin(theta * lerp) / sin_theta;
+
+	return quaternion( q1_weight * q1.w + q2_weight * target.w, q1_weight * q1.x + q2_weight * target.x,
+					   q1_weight * q1.y + q2_weight * target.y, q1_weight * q1.z + q2_weight * target.z);
+}
+
+struct matrix4
+{
+	constexpr matrix4()
+		: elements{}
+	{
+
+	}
+
+	// elements are given row by row
+	constexpr matrix4(float m00, float m01, float m02, float m03,
+					  float m10, float m11, float m12, float m13,
+					  float m20, float m21, float m22, float m23,
+					  float m30, float m31, float m32, float m33)
+		: elements{m00, m01, m02, m03, m10, m11, m12, m13, m20, m21, m22, m23, m30, m31, m32, m33}
+	{
+
+	}
+
+	constexpr float& operator() (int i, int j)
+	{
+		return elements[i * 4 + j];
+	}
+
+	constexpr float operator() (int i, int j) const
+	{
+		return elements[i * 4 + j];
+	}
+
+	float elements[16];
+};
+
+constexpr bool operator == (const matrix4& m1, const matrix4& m2)
+{
+	for (int i = 0; i < 16; ++i)
+	{
+		if (m1.elements[i] != m2.elements[i])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+constexpr vector3 transform_vector(const matrix4& m, const vector3& v)
+{
+	return vector3(m(0, 0) * v.x + m(0, 1) * v.y + m(0, 2) * v.z + m(0, 3),
+				   m(1, 0) * v.x + m(1, 1) * v.y + m(1, 2) * v.z + m(1, 3),
+				   m(2, 0) * v.x + m(2, 1) * v.y + m(2, 2) * v.z + m(2, 3));
+}
+
+// like transform_vector, but leaves out the translation. meant for normals,
+// which need renormalizing if m scales.
+constexpr vector3 transform_direction(const matrix4& m, const vector3& v)
+{
+	return vector3(m(0, 0) * v.x + m(0, 1) * v.y + m(0, 2) * v.z,
+				   m(1, 0) * v.x + m(1, 1) * v.y + m(1, 2) * v.z,
+				   m(2, 0) * v.x + m(2, 1) * v.y + m(2, 2) * v.z);
+}
+
+// transforms count positions stored as separate x, y and z arrays by m,
+// the arrays must not overlap so the loop can be vectorized
+inline void transform_vectors(const matrix4& m, const float* __restrict x, const float* __restrict y, const float* __restrict z,
+					   float* __restrict out_x, float* __restrict out_y, float* __restrict out_z, int count)
+{
+	const float m00 = m(0, 0), m01 = m(0, 1), m02 = m(0, 2), m03 = m(0, 3);
+	const float m10 = m(1, 0), m11 = m(1, 1), m12 = m(1, 2), m13 = m(1, 3);
+	const float m20 = m(2, 0), m21 = m(2, 1), m22 = m(2, 2), m23 = m(2, 3);
+
+	for (int i = 0; i < count; ++i)
+	{
+		out_x[i] = m00 * x[i] + m01 * y[i] + m02 * z[i] + m03;
+		out_y[i] = m10 * x[i] + m11 * y[i] + m12 * z[i] + m13;
+		out_z[i] = m20 * x[i] + m21 * y[i] + m22 * z[i] + m23;
+	}
+}
+
+// same as transform_vectors, but scales the results by weights[i] (used for
+// skinning, where they are added up per vertex afterwards)
+inline void transform_vectors_weighted(const matrix4& m, const float* __restrict x, const float* __restrict y, const float* __restrict z,
+								const float* __restrict weights,
+								float* __restrict out_x, float* __restrict out_y, float* __restrict out_z, int count)
+{
+	const float m00 = m(0, 0), m01 = m(0, 1), m02 = m(0, 2), m03 = m(0, 3);
+	const float m10 = m(1, 0), m11 = m(1, 1), m12 = m(1, 2), m13 = m(1, 3);
+	const float m20 = m(2, 0), m21 = m(2, 1), m22 = m(2, 2), m23 = m(2, 3);
+
+	for (int i = 0; i < count; ++i)
+	{
+		out_x[i] = weights[i] * (m00 * x[i] + m01 * y[i] + m02 * z[i] + m03);
+		out_y[i] = weights[i] * (m10 * x[i] + m11 * y[i] + m12 * z[i] + m13);
+		out_z[i] = weights[i] * (m20 * x[i] + m21 * y[i] + m22 * z[i] + m23);
+	}
+}
+
+constexpr matrix4 operator * (const matrix4& m1, const matrix4& m2)
+{
+	matrix4 res;
+
+	for (int i = 0; i < 4; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+		{
+			res(i, j) = m1(i, 0) * m2(0, j) + m1(i, 1) * m2(1, j) + m1(i, 2) * m2(2, j) + m1(i, 3) * m2(3, j);
+		}
+	}
+
+	return res;
+}
+
+// translation, scale and rotation matrices only store the entries that
+// differ from the identity and convert to matrix4 where needed. multiplying
+// them onto a matrix4 from the right does not evaluate the product but
+// collects the factors in a matrix_chain (see below).
+struct translation_matrix
+{
+	constexpr explicit translation_matrix(const vector3& offset)
+		: offset(offset)
+	{
+
+	}
+
+	constexpr operator matrix4() const
+	{
+		return matrix4(1.0f, 0.0f, 0.0f, offset.x,
+					   0.0f, 1.0f, 0.0f, offset.y,
+					   0.0f, 0.0f, 1.0f, offset.z,
+					   0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	vector3 offset;
+};
+
+struct scale_matrix
+{
+	constexpr explicit scale_matrix(const vector3& factors)
+		: factors(factors)
+	{
+
+	}
+
+	constexpr operator matrix4() const
+	{
+		return matrix4(factors.x, 0.0f, 0.0f, 0.0f,
+					   0.0f, factors.y, 0.0f, 0.0f,
+					   0.0f, 0.0f, factors.z, 0.0f,
+					   0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	vector3 factors;
+};
+
+// upper left 3x3 block of a rotation, the rest is the identity
+struct rotation_matrix
+{
+	constexpr rotation_matrix(float m00, float m01, float m02,
+							  float m10, float m11, float m12,
+							  float m20, float m21, float m22)
+		: elements{m00, m01, m02, m10, m11, m12, m20, m21, m22}
+	{
+
+	}
+
+	constexpr float operator() (int i, int j) const
+	{
+		return elements[i * 3 + j];
+	}
+
+	constexpr operator matrix4() const
+	{
+		return matrix4(elements[0], elements[1], elements[2], 0.0f,
+					   elements[3], elements[4], elements[5], 0.0f,
+					   elements[6], elements[7], elements[8], 0.0f,
+					   0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	float elements[9];
+};
+
+// upper three rows of an affine transform, the last row is (0 0 0 1)
+struct affine_matrix
+{
+	float m00, m01, m02, m03;
+	float m10, m11, m12, m13;
+	float m20, m21, m22, m23;
+};
+
+constexpr affine_matrix operator * (const affine_matrix& a, const translation_matrix& t)
+{
+	const vector3& v = t.offset;
+
+	return affine_matrix{a.m00, a.m01, a.m02, a.m00 * v.x + a.m01 * v.y + a.m02 * v.z + a.m03,
+						 a.m10, a.m11, a.m12, a.m10 * v.x + a.m11 * v.y + a.m12 * v.z + a.m13,
+						 a.m20, a.m21, a.m22, a.m20 * v.x + a.m21 * v.y + a.m22 * v.z + a.m23};
+}
+
+constexpr affine_matrix operator * (const affine_matrix& a, const rotation_matrix& r)
+{
+	return affine_matrix{a.m00 * r(0, 0) + a.m01 * r(1, 0) + a.m02 * r(2, 0),
+						 a.m00 * r(0, 1) + a.m01 * r(1, 1) + a.m02 * r(2, 1),
+						 a.m00 * r(0, 2) + a.m01 * r(1, 2) + a.m02 * r(2, 2),
+						 a.m03,
+						 a.m10 * r(0, 0) + a.m11 * r(1, 0) + a.m12 * r(2, 0),
+						 a.m10 * r(0, 1) + a.m11 * r(1, 1) + a.m12 * r(2, 1),
+						 a.m10 * r(0, 2) + a.m11 * r(1, 2) + a.m12 * r(2, 2),
+						 a.m13,
+						 a.m20 * r(0, 0) + a.m21 * r(1, 0) + a.m22 * r(2, 0),
+						 a.m20 * r(0, 1) + a.m21 * r(1, 1) + a.m22 * r(2, 1),
+						 a.m20 * r(0, 2) + a.m21 * r(1, 2) + a.m22 * r(2, 2),
+						 a.m23};
+}
+
+constexpr affine_matrix operator * (const affine_matrix& a, const scale_matrix& s)
+{
+	const vector3& f = s.factors;
+
+	return affine_matrix{a.m00 * f.x, a.m01 * f.y, a.m02 * f.z, a.m03,
+						 a.m10 * f.x, a.m11 * f.y, a.m12 * f.z, a.m13,
+						 a.m20 * f.x, a.m21 * f.y, a.m22 * f.z, a.m23};
+}
+
+// lazily evaluated product head * tail. a chain like
+// parent * local * translation(pos) * rotation(rot) * non_uniform_scale(scale)
+// folds the sparse factors into the affine tail as they come in and only
+// does one full multiplication when it is converted to a matrix4, instead
+// of one 4x4 product and temporary per factor.
+struct matrix_chain
+{
+	constexpr operator matrix4() const
+	{
+		const matrix4& h = head;
+		const affine_matrix& t = tail;
+
+		return matrix4(h(0, 0) * t.m00 + h(0, 1) * t.m10 + h(0, 2) * t.m20,
+					   h(0, 0) * t.m01 + h(0, 1) * t.m11 + h(0, 2) * t.m21,
+					   h(0, 0) * t.m02 + h(0, 1) * t.m12 + h(0, 2) * t.m22,
+					   h(0, 0) * t.m03 + h(0, 1) * t.m13 + h(0, 2) * t.m23 + h(0, 3),
+					   h(1, 0) * t.m00 + h(1, 1) * t.m10 + h(1, 2) * t.m20,
+					   h(1, 0) * t.m01 + h(1, 1) * t.m11 + h(1, 2) * t.m21,
+					   h(1, 0) * t.m02 + h(1, 1) * t.m12 + h(1, 2) * t.m22,
+					   h(1, 0) * t.m03 + h(1, 1) * t.m13 + h(1, 2) * t.m23 + h(1, 3),
+					   h(2, 0) * t.m00 + h(2, 1) * t.m10 + h(2, 2) * t.m20,
+					   h(2, 0) * t.m01 + h(2, 1) * t.m11 + h(2, 2) * t.m21,
+					   h(2, 0) * t.m02 + h(2, 1) * t.m12 + h(2, 2) * t.m22,
+					   h(2, 0) * t.m03 + h(2, 1) * t.m13 + h(2, 2) * t.m23 + h(2, 3),
+					   h(3, 0) * t.m00 + h(3, 1) * t.m10 + h(3, 2) * t.m20,
+					   h(3, 0) * t.m01 + h(3, 1) * t.m11 + h(3, 2) * t.m21,
+					   h(3, 0) * t.m02 + h(3, 1) * t.m12 + h(3, 2) * t.m22,
+					   h(3, 0) * t.m03 + h(3, 1) * t.m13 + h(3, 2) * t.m23 + h(3, 3));
+	}
+
+	matrix4 head;
+	affine_matrix tail;
+};
+
+constexpr matrix_chain operator * (const matrix4& m, const translation_matrix& t)
+{
+	return matrix_chain{m, affine_matrix{1.0f, 0.0f, 0.0f, t.offset.x,
+										 0.0f, 1.0f, 0.0f, t.offset.y,
+										 0.0f, 0.0f, 1.0f, t.offset.z}};
+}
+
+constexpr matrix_chain operator * (const matrix4& m, const rotation_matrix& r)
+{
+	return matrix_chain{m, affine_matrix{r(0, 0), r(0, 1), r(0, 2), 0.0f,
+										 r(1, 0), r(1, 1), r(1, 2), 0.0f,
+										 r(2, 0), r(2, 1), r(2, 2), 0.0f}};
+}
+
+constexpr matrix_chain operator * (const matrix4& m, const scale_matrix& s)
+{
+	return matrix_chain{m, affine_matrix{s.factors.x, 0.0f, 0.0f, 0.0f,
+										 0.0f, s.factors.y, 0.0f, 0.0f,
+										 0.0f, 0.0f, s.factors.z, 0.0f}};
+}
+
+constexpr matrix_chain operator * (matrix_chain c, const translation_matrix& t)
+{
+	c.tail = c.tail * t;
+	return c;
+}
+
+constexpr matrix_chain operator * (matrix_chain c, const rotation_matrix& r)
+{
+	c.tail = c.tail * r;
+	return c;
+}
+
+constexpr matrix_chain operator * (matrix_chain c, const scale_matrix& s)
+{
+	c.tail = c.tail * s;
+	return c;
+}
+
+constexpr translation_matrix translation(const vector3& position)
+{
+	return translation_matrix(position);
+}
+
+constexpr scale_matrix uniform_scale(float scale)
+{
+	return scale_matrix(vector3(scale, scale, scale));
+}
+
+constexpr scale_matrix non_uniform_scale(const vector3& v)
+{
+	return scale_matrix(v);
+}
+
+constexpr rotation_matrix rotation(const quaternion& q)
+{
+	return rotation_matrix(1.0f - 2.0f * (q.y * q.y + q.z * q.z), 2.0f * (q.x * q.y - q.w * q.z), 2.0f * (q.x * q.z + q.w * q.y),
+						   2.0f * (q.x * q.y + q.w * q.z), 1.0f - 2.0f * (q.x * q.x + q.z * q.z), 2.0f * (q.y * q.z - q.w * q.x),
+						   2.0f * (q.x * q.z - q.w * q.y), 2.0f * (q.y * q.z + q.w * q.x), 1.0f - 2.0f * (q.x * q.x + q.y * q.y));
+}
+
+// same matrix as glFrustum
+constexpr matrix4 frustum_projection(float left, float right, float bottom, float top, float near_plane, float far_plane)
+{
+	return matrix4(2.0f * near_plane / (right - left), 0.0f, (right + left) / (right - left), 0.0f,
+				   0.0f, 2.0f * near_plane / (top - bottom), (top + bottom) / (top - bottom), 0.0f,
+				   0.0f, 0.0f, -(far_plane + near_plane) / (far_plane - near_plane), -2.0f * far_plane * near_plane / (far_plane - near_plane),
+				   0.0f, 0.0f, -1.0f, 0.0f);
+}
+
+// points p with dot_product(normal, p) + distance >= 0 are inside
+struct plane
+{
+	vector3 normal;
+	float distance = 0.0f;
+};
+
+// left, right, bottom, top, near and far plane, facing inwards
+struct frustum
+{
+	plane planes[6];
+};
+
+// the clip volume of m (usually projection * modelview) in the space m
+// transforms from, so objects can be tested without transforming them
+inline frustum extract_frustum(const matrix4& m)
+{
+	frustum ret;
+
+	for (int i = 0; i < 6; ++i)
+	{
+		int row = i / 2;
+		float sign = i % 2 == 0 ? 1.0f : -1.0f;
+		vector3 normal(m(3, 0) + sign * m(row, 0), m(3, 1) + sign * m(row, 1), m(3, 2) + sign * m(row, 2));
+		float length = vector_length(normal);
+
+		ret.planes[i].normal = normal * (1.0f / length);
+		ret.planes[i].distance = (m(3, 3) + sign * m(row, 3)) / length;
+	}
+
+	return ret;
+}
+
+// conservative, spheres near a corner outside of the frustum still count
+inline bool sphere_in_frustum(const frustum& f, const vector3& center, float radius)
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		if (dot_product(f.planes[i].normal, center) + f.planes[i].distance < -radius)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// axis aligned, starts out empty so the first add() sets it
+struct bounding_box
+{
+	vector3 min = vector3(HUGE_VALF, HUGE_VALF, HUGE_VALF);
+	vector3 max = vector3(-HUGE_VALF, -HUGE_VALF, -HUGE_VALF);
+
+	void add(const vector3& p)
+	{
+		min = vector3(std::fmin(min.x, p.x), std::fmin(min.y, p.y), std::fmin(min.z, p.z));
+		max = vector3(std::fmax(max.x, p.x), std::fmax(max.y, p.y), std::fmax(max.z, p.z));
+	}
+
+	void add(const bounding_box& b)
+	{
+		add(b.min);
+		add(b.max);
+	}
+
+	bool empty() const
+	{
+		return min.x > max.x;
+	}
+
+	vector3 center() const
+	{
+		return (min + max) * 0.5f;
+	}
+};
+
+enum class containment
+{
+	outside,
+	intersecting,
+	inside
+};
+
+// uses the corner furthest along and the one furthest against each plane
+// normal, boxes near a corner outside of the frustum count as intersecting
+inline containment box_in_frustum(const frustum& f, const bounding_box& b)
+{
+	containment ret = containment::inside;
+
+	for (int i = 0; i < 6; ++i)
+	{
+		const plane& p = f.planes[i];
+		vector3 furthest(p.normal.x >= 0.0f ? b.max.x : b.min.x, p.normal.y >= 0.0f ? b.max.y : b.min.y, p.normal.z >= 0.0f ? b.max.z : b.min.z);
+		vector3 nearest(p.normal.x >= 0.0f ? b.min.x : b.max.x, p.normal.y >= 0.0f ? b.min.y : b.max.y, p.normal.z >= 0.0f ? b.min.z : b.max.z);
+
+		if (dot_product(p.normal, furthest) + p.distance < 0.0f)
+		{
+			return containment::outside;
+		}
+
+		if (dot_product(p.normal, nearest) + p.distance < 0.0f)
+		{
+			ret = containment::intersecting;
+		}
+	}
+
+	return ret;
+}
+
+// slab test, inverse_direction is 1 / direction per axis. distance is where
+// the ray enters the box, 0 if it starts inside.
+inline bool ray_hits_box(const vector3& origin, const vector3& inverse_direction, const bounding_box& b, float max_distance, float& distance)
+{
+	float x1 = (b.min.x - origin.x) * inverse_direction.x;
+	float x2 = (b.max.x - origin.x) * inverse_direction.x;
+	float y1 = (b.min.y - origin.y) * inverse_direction.y;
+	float y2 = (b.max.y - origin.y) * inverse_direction.y;
+	float z1 = (b.min.z - origin.z) * inverse_direction.z;
+	float z2 = (b.max.z - origin.z) * inverse_direction.z;
+
+	float enter = std::fmax(std::fmax(std::fmin(x1, x2), std::fmin(y1, y2)), std::fmax(std::fmin(z1, z2), 0.0f));
+	float leave = std::fmin(std::fmin(std::fmax(x1, x2), std::fmax(y1, y2)), std::fmin(std::fmax(z1, z2), max_distance));
+
+	distance = enter;
+	return enter <= leave;
+}
+
+constexpr matrix4 identity()
+{
+	return matrix4(1.0f, 0.0f, 0.0f, 0.0f,
+				   0.0f, 1.0f, 0.0f, 0.0f,
+				   0.0f, 0.0f, 1.0f, 0.0f,
+				   0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+// sanity checks, evaluated by the compiler
+static_assert(identity() * identity() == identity(), "identity is not idempotent");
+static_assert(rotation(quaternion(1.0f, 0.0f, 0.0f, 0.0f)) == identity(), "unit quaternion does not map to identity");
+static_assert(translation(vector3(1.0f, 2.0f, 3.0f)) * translation(vector3(-1.0f, -2.0f, -3.0f)) == identity(),
+			  "translations do not cancel out");
+static_assert(non_uniform_scale(vector3(2.0f, 2.0f, 2.0f)) == uniform_scale(2.0f), "scale functions disagree");
+static_assert(transform_vector(translation(vector3(1.0f, 2.0f, 3.0f)) * uniform_scale(2.0f), vector3(1.0f, 1.0f, 1.0f))
+			  == vector3(3.0f, 4.0f, 5.0f), "transforms are not applied right to left");
+static_assert(cross_product(vector3(1.0f, 0.0f, 0.0f), vector3(0.0f, 1.0f, 0.0f)) == vector3(0.0f, 0.0f, 1.0f),
+			  "cross product is not right handed");
+static_assert(transform_direction(translation(vector3(1.0f, 2.0f, 3.0f)), vector3(0.0f, 0.0f, 1.0f)) == vector3(0.0f, 0.0f, 1.0f),
+			  "directions are translated");
+static_assert(identity() * translation(vector3(1.0f, 2.0f, 3.0f)) * rotation(quaternion(0.0f, 0.0f, 0.0f, 1.0f)) * uniform_scale(2.0f)
+			  == identity() * matrix4(translation(vector3(1.0f, 2.0f, 3.0f))) * matrix4(rotation(quaternion(0.0f, 0.0f, 0.0f, 1.0f)))
+			  * matrix4(uniform_scale(2.0f)), "matrix chain disagrees with the full matrix product");
+
+#endif